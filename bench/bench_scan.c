@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "../src/zombie.h"
+
+// Benchmark: tiempo de un reporte de zombie_detector frente al número de procesos
+// del sistema y al número de hilos de escaneo (-j).
+// Uso: bench_scan [repeticiones] [procesos ...]
+// Salida: CSV con una fila por (procesos, hilos).
+
+#define DEFAULT_REPS 5
+#define DETECTOR_PROG "./zombie_detector"
+
+static const int thread_counts[] = {1, 2, 4, 8, 16};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Crea `count` procesos de relleno que esperan EOF en un pipe.
+ * Al cerrar `release_fd` todos terminan a la vez.
+ */
+static pid_t *spawn_fillers(int count, int *release_fd) {
+    int fds[2];
+    pid_t *pids = malloc(count * sizeof(pid_t));
+    if (!pids || pipe(fds) == -1) {
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < count; i++) {
+        pids[i] = fork();
+        if (pids[i] == -1) {
+            perror("fork (aumente ulimit -u)");
+            exit(EXIT_FAILURE);
+        }
+        if (pids[i] == 0) {
+            char c;
+            close(fds[1]);
+            while (read(fds[0], &c, 1) > 0) {
+            }
+            _exit(0);
+        }
+    }
+    close(fds[0]);
+    *release_fd = fds[1];
+    return pids;
+}
+
+static void release_fillers(pid_t *pids, int count, int release_fd) {
+    close(release_fd);
+    for (int i = 0; i < count; i++) {
+        waitpid(pids[i], NULL, 0);
+    }
+    free(pids);
+}
+
+/**
+ * @brief Ejecuta el detector `reps` veces con `threads` hilos y devuelve la media.
+ */
+static double time_scan(int threads, int reps) {
+    char jobs[16];
+    snprintf(jobs, sizeof(jobs), "%d", threads);
+    char *argv[] = {DETECTOR_PROG, "-j", jobs, NULL};
+    zombie_file_action_t quiet = {ZOMBIE_FA_OPEN, STDOUT_FILENO, -1, "/dev/null", O_WRONLY, 0};
+    zombie_spawn_opts_t opts = {ZOMBIE_SPAWN_POSIX, NULL, &quiet, 1};
+    zombie_child_status_t st;
+    double total = 0;
+
+    for (int r = 0; r < reps; r++) {
+        double start = now_sec();
+        pid_t pid = zombie_spawn_ex(DETECTOR_PROG, argv, &opts);
+        if (pid == -1 || zombie_wait_child(pid, 60000, &st) != 0 || st.exit_status != 0) {
+            fprintf(stderr, "Fallo al ejecutar %s (¿compilado con make?)\n", DETECTOR_PROG);
+            exit(EXIT_FAILURE);
+        }
+        total += now_sec() - start;
+    }
+    return total / reps;
+}
+
+int main(int argc, char *argv[]) {
+    int reps = argc > 1 ? atoi(argv[1]) : DEFAULT_REPS;
+    int default_counts[] = {0, 1000, 5000, 10000};
+    int n_counts = argc > 2 ? argc - 2 : (int)(sizeof(default_counts) / sizeof(default_counts[0]));
+
+    if (reps <= 0) {
+        fprintf(stderr, "Uso: %s [repeticiones] [procesos ...]\n", argv[0]);
+        return 1;
+    }
+
+    // El backend pidfd solo cosecha al detector: los procesos de relleno se esperan aquí
+    if (zombie_init_backend(ZOMBIE_BACKEND_PIDFD) == -1) {
+        perror("zombie_init_backend");
+        return 1;
+    }
+
+    printf("extra_processes,threads,seconds\n");
+
+    for (int i = 0; i < n_counts; i++) {
+        int count = argc > 2 ? atoi(argv[i + 2]) : default_counts[i];
+        int release_fd = -1;
+        pid_t *fillers = count > 0 ? spawn_fillers(count, &release_fd) : NULL;
+
+        for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+            printf("%d,%d,%.4f\n", count, thread_counts[t], time_scan(thread_counts[t], reps));
+            fflush(stdout);
+        }
+
+        if (fillers) release_fillers(fillers, count, release_fd);
+    }
+
+    return 0;
+}
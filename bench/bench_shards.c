@@ -0,0 +1,159 @@
+#define _GNU_SOURCE // struct ucred (SO_PEERCRED)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "../src/zombie.h"
+
+// Benchmark: trabajos/seg de process_daemon frente al número de shards (--shards).
+// Cada fila arranca un demonio, le envía los trabajos desde varios clientes --submit
+// en paralelo (trabajos vacíos: se mide el coste de fork + cosecha + respuesta) y lo
+// detiene con SIGTERM.
+// Uso: bench_shards [trabajos] [clientes] [shards ...]
+// Salida: CSV con una fila por número de shards.
+
+#define DEFAULT_JOBS 4000
+#define DEFAULT_CLIENTS 4
+#define DAEMON_PROG "./process_daemon"
+#define JOB_SOCKET "/tmp/process_daemon.sock"
+#define DAEMON_WAIT_MS 5000
+
+static const int default_shards[] = {1, 2, 4, 8};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * @brief Ejecuta el demonio con `argv` y espera a que termine su primer proceso
+ * (el demonio se separa con un doble fork).
+ */
+static void run_daemon_cmd(char *argv[]) {
+    zombie_file_action_t quiet = {ZOMBIE_FA_OPEN, STDOUT_FILENO, -1, "/dev/null", O_WRONLY, 0};
+    zombie_spawn_opts_t opts = {ZOMBIE_SPAWN_POSIX, NULL, &quiet, 1};
+    zombie_child_status_t st;
+    pid_t pid = zombie_spawn_ex(DAEMON_PROG, argv, &opts);
+    if (pid == -1 || zombie_wait_child(pid, 10000, &st) != 0 || st.exit_status != 0) {
+        fprintf(stderr, "Fallo al ejecutar %s (¿compilado con make?)\n", DAEMON_PROG);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Espera a que el demonio escuche en JOB_SOCKET.
+ * @return PID del demonio (SO_PEERCRED del socket), o -1 si no arrancó a tiempo.
+ */
+static pid_t daemon_pid(void) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, JOB_SOCKET, sizeof(addr.sun_path) - 1);
+
+    for (int waited = 0; waited < DAEMON_WAIT_MS; waited += 10) {
+        int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (fd != -1 && connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+            struct ucred cred;
+            socklen_t len = sizeof(cred);
+            int ok = getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0;
+            close(fd);
+            if (ok) return cred.pid;
+        }
+        if (fd != -1) close(fd);
+        sleep_ms(10);
+    }
+    return -1;
+}
+
+/**
+ * @brief Arranca un demonio con `shards` supervisores, le envía `jobs` trabajos desde
+ * `clients` clientes y devuelve los segundos hasta la última respuesta.
+ */
+static double time_jobs(int shards, int jobs, int clients) {
+    char shards_arg[16];
+    snprintf(shards_arg, sizeof(shards_arg), "%d", shards);
+    // Sin trabajadores periódicos durante la medición
+    char *start_argv[] = {DAEMON_PROG, "--shards", shards_arg, "--interval-us", "1000000000", NULL};
+    run_daemon_cmd(start_argv);
+    pid_t daemon = daemon_pid();
+    if (daemon == -1) {
+        fprintf(stderr, "El demonio no abrió %s a tiempo.\n", JOB_SOCKET);
+        exit(EXIT_FAILURE);
+    }
+
+    pid_t *submitters = malloc((size_t) clients * sizeof(pid_t));
+    char counts[clients][16];
+    zombie_file_action_t quiet = {ZOMBIE_FA_OPEN, STDOUT_FILENO, -1, "/dev/null", O_WRONLY, 0};
+    zombie_spawn_opts_t opts = {ZOMBIE_SPAWN_POSIX, NULL, &quiet, 1};
+    zombie_child_status_t st;
+    int failed = 0;
+
+    double start = now_sec();
+    for (int c = 0; c < clients; c++) {
+        // El resto de la división se reparte entre los primeros clientes
+        snprintf(counts[c], sizeof(counts[c]), "%d", jobs / clients + (c < jobs % clients));
+        char *argv[] = {DAEMON_PROG, "--submit", counts[c], "--work-us", "0", NULL};
+        submitters[c] = zombie_spawn_ex(DAEMON_PROG, argv, &opts);
+        if (submitters[c] == -1) failed = 1;
+    }
+    for (int c = 0; c < clients; c++) {
+        if (submitters[c] == -1) continue;
+        if (zombie_wait_child(submitters[c], 120000, &st) != 0 || st.exit_status != 0) failed = 1;
+    }
+    double elapsed = now_sec() - start;
+    free(submitters);
+
+    // El demonio no es hijo nuestro: se espera a que retire su socket al apagarse
+    kill(daemon, SIGTERM);
+    for (int waited = 0; access(JOB_SOCKET, F_OK) == 0 && waited < DAEMON_WAIT_MS; waited += 10) {
+        sleep_ms(10);
+    }
+    if (failed) {
+        fprintf(stderr, "Algún cliente --submit falló con %d shards.\n", shards);
+        exit(EXIT_FAILURE);
+    }
+    return elapsed;
+}
+
+int main(int argc, char *argv[]) {
+    int jobs = argc > 1 ? atoi(argv[1]) : DEFAULT_JOBS;
+    int clients = argc > 2 ? atoi(argv[2]) : DEFAULT_CLIENTS;
+    int n_shards = argc > 3 ? argc - 3 : (int) (sizeof(default_shards) / sizeof(default_shards[0]));
+
+    if (jobs <= 0 || clients <= 0 || clients > jobs) {
+        fprintf(stderr, "Uso: %s [trabajos] [clientes] [shards ...]\n", argv[0]);
+        return 1;
+    }
+    if (access(JOB_SOCKET, F_OK) == 0 && daemon_pid() != -1) {
+        fprintf(stderr, "Ya hay un demonio escuchando en %s: deténgalo antes del benchmark.\n", JOB_SOCKET);
+        return 1;
+    }
+
+    if (zombie_init_backend(ZOMBIE_BACKEND_PIDFD) == -1) {
+        perror("zombie_init_backend");
+        return 1;
+    }
+
+    printf("shards,clients,jobs,seconds,jobs_per_sec\n");
+
+    for (int i = 0; i < n_shards; i++) {
+        int shards = argc > 3 ? atoi(argv[i + 3]) : default_shards[i];
+        double seconds = time_jobs(shards, jobs, clients);
+        printf("%d,%d,%d,%.4f,%.0f\n", shards, clients, jobs, seconds, jobs / seconds);
+        fflush(stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+
+#include "../src/zombie.h"
+
+// Benchmark: spawns/seg de zombie_spawn_ex frente al RSS del proceso padre,
+// comparando el camino fork()+execve, posix_spawn (clone CLONE_VM|CLONE_VFORK) y el
+// servidor de spawn (zygote creado antes de que crezca el RSS).
+// Uso: bench_spawn [spawns_por_medida] [rss_mb ...]
+// Salida: CSV con una fila por (método, RSS).
+
+#define DEFAULT_SPAWNS 500
+#define CHILD_PROG "/bin/true"
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Hace crecer el RSS del padre hasta `mb` MiB tocando cada página.
+ */
+static char *grow_rss(size_t mb) {
+    if (mb == 0) return NULL;
+    size_t bytes = mb * 1024 * 1024;
+    char *mem = malloc(bytes);
+    if (!mem) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t off = 0; off < bytes; off += page) {
+        mem[off] = 1;
+    }
+    return mem;
+}
+
+/**
+ * @brief Espera a que el backend coseche todos los hijos creados hasta ahora.
+ */
+static void wait_all_reaped(void) {
+    zombie_stats_t st;
+    struct timespec tick = {0, 1000000};
+    for (;;) {
+        zombie_get_stats(&st);
+        if (st.zombies_active == 0) return;
+        nanosleep(&tick, NULL);
+    }
+}
+
+static void run(zombie_spawn_method_t method, const char *name, size_t rss_mb, int spawns) {
+    char *argv[] = {CHILD_PROG, NULL};
+    // El hijo no debe escribir en la terminal del benchmark
+    zombie_file_action_t quiet = {ZOMBIE_FA_OPEN, STDOUT_FILENO, -1, "/dev/null", O_WRONLY, 0};
+    zombie_spawn_opts_t opts = {method, NULL, &quiet, 1};
+
+    double start = now_sec();
+    for (int i = 0; i < spawns; i++) {
+        if (zombie_spawn_ex(CHILD_PROG, argv, &opts) == -1) {
+            perror("zombie_spawn_ex");
+            exit(EXIT_FAILURE);
+        }
+    }
+    wait_all_reaped();
+    double elapsed = now_sec() - start;
+
+    printf("%s,%zu,%d,%.3f,%.0f\n", name, rss_mb, spawns, elapsed, spawns / elapsed);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    int spawns = argc > 1 ? atoi(argv[1]) : DEFAULT_SPAWNS;
+    size_t default_sizes[] = {0, 256, 1024};
+    int n_sizes = argc > 2 ? argc - 2 : (int)(sizeof(default_sizes) / sizeof(default_sizes[0]));
+
+    if (spawns <= 0) {
+        fprintf(stderr, "Uso: %s [spawns_por_medida] [rss_mb ...]\n", argv[0]);
+        return 1;
+    }
+
+    // El auxiliar se crea aquí, con el RSS inicial del benchmark
+    if (zombie_init_spawn_server(ZOMBIE_BACKEND_PIDFD) == -1) {
+        perror("zombie_init_spawn_server");
+        return 1;
+    }
+
+    printf("method,rss_mb,spawns,seconds,spawns_per_sec\n");
+
+    size_t current_mb = 0;
+    for (int i = 0; i < n_sizes; i++) {
+        size_t target = argc > 2 ? (size_t) atol(argv[i + 2]) : default_sizes[i];
+        // El RSS solo crece: cada medida añade la diferencia con la anterior
+        if (target > current_mb) {
+            grow_rss(target - current_mb);
+            current_mb = target;
+        }
+        run(ZOMBIE_SPAWN_FORK, "fork", current_mb, spawns);
+        run(ZOMBIE_SPAWN_POSIX, "posix_spawn", current_mb, spawns);
+        run(ZOMBIE_SPAWN_SERVER, "spawn_server", current_mb, spawns);
+    }
+
+    return 0;
+}
@@ -1,98 +1,1622 @@
+#define _GNU_SOURCE // pidfd_open (syscall), epoll y signalfd son extensiones de Linux
 #include "zombie.h"
+#include "zombie_internal.h"
 #include <stdio.h>
 #include <signal.h>
 #include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/prctl.h>
+#include <poll.h>
 #include <errno.h>
 #include <pthread.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sched.h>
+#include <linux/futex.h>
 
-// Variables y Mutex para estadísticas compartidas (thread-safe)
-static zombie_stats_t stats = {0, 0, 0};
-static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434 // Igual en todas las arquitecturas (Linux >= 5.3)
+#endif
+
+#define PIDFD_MAX_EVENTS 256   // Eventos procesados por cada epoll_wait()
+#define PIDFD_OVERFLOW_MAX 4096 // Hijos sin pidfd (EMFILE) vigilados por sondeo
+#define PIDFD_POLL_MS 100      // Intervalo de sondeo para los hijos sin pidfd
+#define SIGNALFD_BATCH 64      // siginfo leídos por cada read() del signalfd
+
+// Servidor de spawn (zygote): proceso auxiliar creado al inicio, con RSS mínimo
+#define ZYGOTE_MSG_MAX 65536     // Tamaño máximo de una solicitud (comando, argv, env, acciones)
+#define ZYGOTE_MAX_FDS 16        // Descriptores enviados por SCM_RIGHTS en una solicitud
+#define ZYGOTE_EXIT_BATCH 256    // Salidas reportadas por mensaje
+#define ZYGOTE_SOCK_BUF (1 << 20)
+
+// Registro de hijos (REGISTRY_SLOTS y REGISTRY_PROBES en zombie_internal.h): la clave
+// de cada ranura es una palabra de 64 bits (pid | estado | banderas) que se modifica
+// solo con CAS, por lo que el registro puede actualizarse desde un signal handler.
+#define ORPHAN_TTL_US 1000000     // Una salida sin registrar solo se empareja durante 1 s
+
+// Tabla de consumo por comando (rusage de wait4): direccionamiento abierto sobre un
+// arreglo fijo, ranuras reclamadas con CAS y contadores atómicos (usable desde el handler)
+#define USAGE_SLOTS 256           // Potencia de dos
+
+enum { SLOT_FREE = 0, SLOT_BUSY, SLOT_RUNNING, SLOT_EXITED };
+#define KEY_PENDING (UINT64_C(1) << 36) // Un cosechador dejó el estado mientras la ranura estaba BUSY
+#define KEY_ORPHAN  (UINT64_C(1) << 37) // Cosechado antes de que el padre registrara el hijo
+
+typedef struct {
+    uint64_t key;      // pid (32 bits) | estado (4) | banderas
+    uint64_t spawn_us; // Escrito solo por quien registra el hijo
+    uint64_t exit_us;  // Escrito solo por el cosechador
+    int status;        // Estado crudo de waitpid (-1 si se desconoce)
+    uint32_t seq;      // Palabra futex: se incrementa cada vez que la ranura pasa a EXITED
+} child_slot_t;
+
+static child_slot_t registry[REGISTRY_SLOTS];
+static uint64_t registry_untracked; // Hijos que no cupieron en su ventana de sondeo
+
+// Contadores de 64 bits actualizados con atómicos (sin mutex en el camino de fork).
+// Se separan en líneas de caché distintas: los escriben hilos distintos (fork vs cosecha).
+static struct {
+    uint64_t created __attribute__((aligned(64)));
+    uint64_t reaped __attribute__((aligned(64)));
+} counters;
+
+// Histograma logarítmico de latencia fork -> cosecha: el bucket i cubre [2^i, 2^(i+1)) µs
+static uint64_t latency_buckets[ZOMBIE_LATENCY_BUCKETS];
+static uint64_t latency_max_us;
+
+enum { USAGE_FREE = 0, USAGE_BUSY, USAGE_READY };
+
+typedef struct {
+    uint32_t state;                       // USAGE_FREE -> USAGE_BUSY -> USAGE_READY (solo con CAS)
+    char command[ZOMBIE_USAGE_COMM_LEN];
+    uint64_t children;
+    uint64_t utime_us;
+    uint64_t stime_us;
+    uint64_t maxrss_kb;
+    uint64_t minflt;
+    uint64_t majflt;
+    uint64_t nvcsw;
+    uint64_t nivcsw;
+} usage_slot_t;
+
+static usage_slot_t usage_table[USAGE_SLOTS];
+static usage_slot_t usage_other = {USAGE_READY, "(other)", 0, 0, 0, 0, 0, 0, 0, 0}; // Tabla llena
+
+// Estado del backend activo
+extern char **environ;
+
+static zombie_backend_t active_backend = ZOMBIE_BACKEND_SIGNAL;
+static int pidfd_epoll = -1;
+static pid_t pidfd_owner = -1; // Proceso dueño del epoll (los hijos lo heredan, pero no es suyo)
+static pthread_t pidfd_thread;
+
+// Backend signalfd: descriptor, hilo y máscara original (restaurada en los hijos)
+static int sigchld_fd = -1;
+static pthread_t signalfd_thread;
+static sigset_t saved_sigmask;
+
+// Servidor de spawn: canal de solicitudes (síncrono, serializado) y canal de salidas
+static int zygote_req_fd = -1;
+static int zygote_evt_fd = -1;
+static pid_t zygote_pid = -1;
+static int zygote_alive = 0;
+static pthread_mutex_t zygote_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Hijos para los que pidfd_open() falló: el hilo cosechador los sondea con WNOHANG
+static pid_t overflow_pids[PIDFD_OVERFLOW_MAX];
+static int overflow_count = 0;
+static pthread_mutex_t overflow_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// --- Contabilidad común a todos los backends ---
+// Todas estas funciones son async-signal-safe: solo usan atómicos y clock_gettime().
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000u + (uint64_t) ts.tv_nsec / 1000u;
+}
+
+static uint64_t key_make(pid_t pid, int state) {
+    return (uint64_t)(uint32_t) pid | ((uint64_t) state << 32);
+}
+
+static pid_t key_pid(uint64_t k) { return (pid_t)(uint32_t) k; }
+static int key_state(uint64_t k) { return (int)((k >> 32) & 0xf); }
+
+static child_slot_t *registry_at(unsigned int base, int i) {
+    return &registry[(base + i) & (REGISTRY_SLOTS - 1)];
+}
+
+static void record_latency(uint64_t latency_us) {
+    int bucket = latency_us < 2 ? 0 : 63 - __builtin_clzll(latency_us);
+    if (bucket >= ZOMBIE_LATENCY_BUCKETS) bucket = ZOMBIE_LATENCY_BUCKETS - 1;
+    __atomic_fetch_add(&latency_buckets[bucket], 1, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&latency_max_us, __ATOMIC_RELAXED);
+    while (latency_us > max &&
+           !__atomic_compare_exchange_n(&latency_max_us, &max, latency_us, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // max se recarga con el valor actual en cada fallo del CAS
+    }
+}
+
+static int futex(uint32_t *uaddr, int op, uint32_t val, const struct timespec *timeout) {
+    return (int) syscall(SYS_futex, uaddr, op, val, timeout, NULL, 0);
+}
+
+static void atomic_max_u64(uint64_t *target, uint64_t value) {
+    uint64_t cur = __atomic_load_n(target, __ATOMIC_RELAXED);
+    while (value > cur &&
+           !__atomic_compare_exchange_n(target, &cur, value, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * @brief Busca (o reclama) la ranura de `command` en la tabla de consumo.
+ * Una ranura BUSY se salta en lugar de esperarla (puede ser del hilo que este handler
+ * interrumpió): en ese caso el comando puede quedar en dos ranuras, que
+ * zombie_get_usage fusiona al consultar.
+ */
+static usage_slot_t *usage_slot(const char *command) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (const char *p = command; *p; p++) hash = (hash ^ (uint8_t) *p) * 16777619u;
+
+    for (int i = 0; i < USAGE_SLOTS; i++) {
+        usage_slot_t *slot = &usage_table[(hash + (uint32_t) i) & (USAGE_SLOTS - 1)];
+        uint32_t state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+        if (state == USAGE_READY && strncmp(slot->command, command, ZOMBIE_USAGE_COMM_LEN) == 0) {
+            return slot;
+        }
+        if (state == USAGE_FREE &&
+            __atomic_compare_exchange_n(&slot->state, &state, USAGE_BUSY, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            strncpy(slot->command, command, ZOMBIE_USAGE_COMM_LEN - 1);
+            __atomic_store_n(&slot->state, USAGE_READY, __ATOMIC_RELEASE);
+            return slot;
+        }
+    }
+    return &usage_other;
+}
+
+static uint64_t timeval_us(const struct timeval *tv) {
+    return (uint64_t) tv->tv_sec * 1000000u + (uint64_t) tv->tv_usec;
+}
+
+/**
+ * @brief Suma el rusage de un hijo cosechado a la fila de su comando. Async-signal-safe.
+ */
+static void usage_record(const char *command, const struct rusage *ru) {
+    usage_slot_t *slot = usage_slot(command);
+    __atomic_fetch_add(&slot->children, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&slot->utime_us, timeval_us(&ru->ru_utime), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&slot->stime_us, timeval_us(&ru->ru_stime), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&slot->minflt, (uint64_t) ru->ru_minflt, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&slot->majflt, (uint64_t) ru->ru_majflt, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&slot->nvcsw, (uint64_t) ru->ru_nvcsw, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&slot->nivcsw, (uint64_t) ru->ru_nivcsw, __ATOMIC_RELAXED);
+    atomic_max_u64(&slot->maxrss_kb, (uint64_t) ru->ru_maxrss);
+}
+
+/**
+ * @brief Lee el comm de un hijo que ya terminó pero aún no fue cosechado.
+ * Solo usa open/read/close (async-signal-safe); "(unknown)" si ya no existe.
+ */
+static void child_comm(pid_t pid, char comm[ZOMBIE_USAGE_COMM_LEN]) {
+    char path[32] = "/proc/";
+    char digits[12];
+    int n = 0, len = 6;
+    do {
+        digits[n++] = (char) ('0' + pid % 10);
+        pid /= 10;
+    } while (pid > 0);
+    while (n > 0) path[len++] = digits[--n];
+    memcpy(path + len, "/comm", sizeof("/comm"));
+
+    ssize_t got = -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+        got = read(fd, comm, ZOMBIE_USAGE_COMM_LEN - 1);
+        close(fd);
+    }
+    if (got <= 0) {
+        memcpy(comm, "(unknown)", sizeof("(unknown)"));
+        return;
+    }
+    if (comm[got - 1] == '\n') got--;
+    comm[got] = '\0';
+}
+
+/**
+ * @brief Cosecha, sin bloquear, a cualquier hijo terminado con wait4().
+ * waitid(WNOWAIT) identifica al hijo sin cosecharlo para leer antes su comm.
+ * Async-signal-safe.
+ * @return PID cosechado, 0 si no hay hijos terminados, -1 en error (p.ej. ECHILD).
+ */
+static pid_t reap_any(int *status, struct rusage *ru, char comm[ZOMBIE_USAGE_COMM_LEN]) {
+    for (;;) {
+        siginfo_t info;
+        info.si_pid = 0;
+        if (waitid(P_ALL, 0, &info, WEXITED | WNOHANG | WNOWAIT) == -1) return -1;
+        if (info.si_pid == 0) return 0;
+
+        child_comm(info.si_pid, comm);
+        pid_t pid = wait4(info.si_pid, status, WNOHANG, ru);
+        // Otro hilo lo cosechó entre waitid() y wait4(): se busca el siguiente
+        if (pid == -1 && errno == ECHILD) continue;
+        return pid;
+    }
+}
+
+/**
+ * @brief Publica la salida de un hijo (ranura en BUSY -> EXITED) y despierta a los que esperan.
+ */
+static void slot_publish_exit(child_slot_t *slot, pid_t pid, uint64_t flags) {
+    if (!(flags & KEY_ORPHAN) && slot->spawn_us != 0) {
+        record_latency(slot->exit_us - slot->spawn_us);
+    }
+    __atomic_store_n(&slot->key, key_make(pid, SLOT_EXITED) | flags, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&slot->seq, 1, __ATOMIC_RELEASE);
+    futex(&slot->seq, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL);
+}
+
+/**
+ * @brief Recorre la ventana de `pid` y devuelve su entrada viva (RUNNING o BUSY) si
+ * existe; si no, la primera ranura que contiene `pid` o, antes de ella, la primera
+ * libre. Como las ranuras nunca vuelven a quedar libres, quien registra un hijo y
+ * quien lo cosecha coinciden en la misma ranura (o en el CAS sobre ella). Solo si
+ * no hay ninguna entrada de `pid` ni hueco se devuelve la salida más antigua para
+ * reutilizarla (las salidas se conservan hasta entonces).
+ * @return Ranura candidata con su clave en *key_out, o NULL si no hay espacio.
+ */
+static child_slot_t *registry_find(pid_t pid, uint64_t *key_out) {
+    unsigned int base = zombie_registry_hash(pid);
+    child_slot_t *found = NULL, *victim = NULL;
+    uint64_t found_key = 0, victim_key = 0;
+    uint64_t oldest = UINT64_MAX;
+
+    for (int i = 0; i < REGISTRY_PROBES; i++) {
+        child_slot_t *slot = registry_at(base, i);
+        uint64_t k = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+        if (key_state(k) == SLOT_FREE) {
+            if (!found) {
+                found = slot;
+                found_key = k;
+            }
+            break; // Tras un hueco no hay más entradas de esta ventana
+        }
+        if (key_pid(k) == pid) {
+            if (key_state(k) != SLOT_EXITED) {
+                *key_out = k;
+                return slot;
+            }
+            if (!found) {
+                found = slot;
+                found_key = k;
+            }
+        } else if (key_state(k) == SLOT_EXITED && slot->exit_us < oldest) {
+            oldest = slot->exit_us;
+            victim = slot;
+            victim_key = k;
+        }
+    }
+    if (found) {
+        *key_out = found_key;
+        return found;
+    }
+    *key_out = victim_key;
+    return victim;
+}
+
+/**
+ * @brief Busca en la ventana de `pid` una ranura distinta de `self` cuya clave sea `key`.
+ * Un registro y una cosecha simultáneos pueden desalojar ranuras distintas para el
+ * mismo hijo; tras publicar su ranura, cada uno busca la del otro para unirlas.
+ */
+static child_slot_t *registry_other(pid_t pid, const child_slot_t *self, uint64_t key) {
+    unsigned int base = zombie_registry_hash(pid);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST); // Ordena la publicación propia antes de leer la ajena
+    for (int i = 0; i < REGISTRY_PROBES; i++) {
+        child_slot_t *slot = registry_at(base, i);
+        uint64_t k = __atomic_load_n(&slot->key, __ATOMIC_SEQ_CST);
+        if (key_state(k) == SLOT_FREE) return NULL;
+        if (slot != self && k == key) return slot;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Retira una entrada huérfana ya absorbida por la ranura del registro: pasa a
+ * no coincidir con ningún PID y queda como primera candidata a desalojo.
+ */
+static void registry_retire(child_slot_t *slot, uint64_t key) {
+    __atomic_compare_exchange_n(&slot->key, &key, key_make(0, SLOT_EXITED), 0,
+                                __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Registra un hijo recién creado. Si el cosechador se adelantó (el hijo terminó
+ * y fue cosechado antes de llegar aquí), completa la entrada huérfana que dejó.
+ */
+static void registry_child_created(pid_t pid, uint64_t spawn_us) {
+    for (;;) {
+        uint64_t k;
+        child_slot_t *slot = registry_find(pid, &k);
+        if (!slot) {
+            __atomic_fetch_add(&registry_untracked, 1, __ATOMIC_RELAXED);
+            return;
+        }
+
+        int mine = key_pid(k) == pid && key_state(k) != SLOT_FREE;
+        if (mine && key_state(k) == SLOT_BUSY) {
+            sched_yield(); // Un cosechador está creando la entrada huérfana ahora mismo
+            continue;
+        }
+
+        // Huérfana reciente: el hijo ya fue cosechado, status y exit_us ya están escritos.
+        // Cualquier otra entrada con el mismo pid es obsoleta (pid reutilizado).
+        int orphan = mine && key_state(k) == SLOT_EXITED && (k & KEY_ORPHAN) &&
+                     slot->exit_us + ORPHAN_TTL_US > spawn_us;
+        uint64_t busy_key = key_make(pid, SLOT_BUSY);
+
+        if (!__atomic_compare_exchange_n(&slot->key, &k, busy_key, 0,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            continue; // La ranura cambió entre la búsqueda y el CAS
+        }
+
+        slot->spawn_us = spawn_us;
+
+        if (orphan) {
+            slot_publish_exit(slot, pid, 0);
+            return;
+        }
+
+        // Publicar RUNNING, salvo que un cosechador marcara PENDING mientras tanto
+        uint64_t running_key = key_make(pid, SLOT_RUNNING);
+        if (!__atomic_compare_exchange_n(&slot->key, &busy_key, running_key, 0,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE)) {
+            slot_publish_exit(slot, pid, 0);
+            return;
+        }
+
+        // Un cosechador que no vio esta ranura dejó la salida en una huérfana desalojada
+        uint64_t orphan_key = key_make(pid, SLOT_EXITED) | KEY_ORPHAN;
+        child_slot_t *other = registry_other(pid, slot, orphan_key);
+        if (other && other->exit_us + ORPHAN_TTL_US > spawn_us &&
+            __atomic_compare_exchange_n(&slot->key, &running_key, busy_key, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            int status = other->status;
+            uint64_t exit_us = other->exit_us;
+            // Si la huérfana se desalojó durante la copia, el estado se desconoce
+            if (__atomic_load_n(&other->key, __ATOMIC_ACQUIRE) != orphan_key) {
+                status = -1;
+                exit_us = now_us();
+            }
+            slot->status = status;
+            slot->exit_us = exit_us;
+            slot_publish_exit(slot, pid, 0);
+            registry_retire(other, orphan_key);
+        }
+        return;
+    }
+}
+
+/**
+ * @brief Registra la salida de un hijo. Async-signal-safe: nunca espera a otro hilo.
+ * @param status Estado crudo de waitpid, o -1 si se desconoce.
+ */
+static void registry_child_reaped(pid_t pid, int status, uint64_t exit_us) {
+    for (;;) {
+        uint64_t k;
+        child_slot_t *slot = registry_find(pid, &k);
+        if (!slot) return;
+
+        int mine = key_pid(k) == pid && key_state(k) != SLOT_FREE;
+
+        if (mine && key_state(k) == SLOT_RUNNING) {
+            if (!__atomic_compare_exchange_n(&slot->key, &k, key_make(pid, SLOT_BUSY), 0,
+                                             __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                continue;
+            }
+            slot->status = status;
+            slot->exit_us = exit_us;
+            slot_publish_exit(slot, pid, 0);
+            return;
+        }
+
+        if (mine && key_state(k) == SLOT_BUSY) {
+            // El padre está registrando este hijo (quizá en el mismo hilo que este
+            // handler interrumpió): dejar el resultado y marcar PENDING sin esperar.
+            slot->status = status;
+            slot->exit_us = exit_us;
+            if (!__atomic_compare_exchange_n(&slot->key, &k, k | KEY_PENDING, 0,
+                                             __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                continue;
+            }
+            return;
+        }
+
+        // Sin entrada de este pid (libre o desalojada) u obsoleta: crear una huérfana
+        if (!__atomic_compare_exchange_n(&slot->key, &k, key_make(pid, SLOT_BUSY), 0,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        slot->spawn_us = 0;
+        slot->status = status;
+        slot->exit_us = exit_us;
+        slot_publish_exit(slot, pid, KEY_ORPHAN);
+
+        // Un registro simultáneo pudo desalojar otra ranura: completarla en su sitio
+        uint64_t running_key = key_make(pid, SLOT_RUNNING);
+        child_slot_t *other = registry_other(pid, slot, running_key);
+        if (other && __atomic_compare_exchange_n(&other->key, &running_key, key_make(pid, SLOT_BUSY), 0,
+                                                 __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            other->status = status;
+            other->exit_us = exit_us;
+            slot_publish_exit(other, pid, 0);
+            registry_retire(slot, key_make(pid, SLOT_EXITED) | KEY_ORPHAN);
+        }
+        return;
+    }
+}
+
+/**
+ * @brief Busca la entrada de `pid` y copia su contenido de forma consistente.
+ * @return Ranura encontrada (para esperar en su futex), o NULL si no existe.
+ */
+static child_slot_t *registry_lookup(pid_t pid, uint64_t *key_out, zombie_child_status_t *out) {
+    for (;;) {
+        uint64_t k;
+        child_slot_t *slot = registry_find(pid, &k);
+        if (!slot || key_state(k) == SLOT_FREE || key_pid(k) != pid) return NULL;
+
+        if (key_state(k) == SLOT_BUSY) {
+            sched_yield();
+            continue;
+        }
+
+        // Copia tipo seqlock: válida solo si la clave no cambió durante la lectura
+        uint64_t spawn_us = slot->spawn_us;
+        uint64_t exit_us = slot->exit_us;
+        int status = slot->status;
+        if (__atomic_load_n(&slot->key, __ATOMIC_ACQUIRE) != k) continue;
+
+        out->pid = pid;
+        out->spawn_time_us = (long long) spawn_us;
+        out->exited = 0;
+        out->exit_status = 0;
+        out->term_signal = 0;
+        out->raw_status = -1;
+        if (key_state(k) == SLOT_RUNNING) {
+            out->state = ZOMBIE_CHILD_RUNNING;
+            out->exit_time_us = 0;
+        } else {
+            out->state = ZOMBIE_CHILD_EXITED;
+            out->exit_time_us = (long long) exit_us;
+            out->raw_status = status;
+            if (status != -1 && WIFEXITED(status)) {
+                out->exited = 1;
+                out->exit_status = WEXITSTATUS(status);
+            } else if (status != -1 && WIFSIGNALED(status)) {
+                out->term_signal = WTERMSIG(status);
+            }
+        }
+        *key_out = k;
+        return slot;
+    }
+}
+
+static void account_created(pid_t pid, uint64_t fork_us) {
+    __atomic_fetch_add(&counters.created, 1, __ATOMIC_RELAXED);
+    registry_child_created(pid, fork_us);
+}
+
+/**
+ * @param ru Recursos del hijo según wait4(), o NULL si otro proceso lo cosechó.
+ */
+static void account_reaped_at(pid_t pid, int status, uint64_t exit_us, const struct rusage *ru, const char *comm) {
+    registry_child_reaped(pid, status, exit_us);
+    if (ru) usage_record(comm, ru);
+    __atomic_fetch_add(&counters.reaped, 1, __ATOMIC_RELAXED);
+}
+
+static void account_reaped(pid_t pid, int status, const struct rusage *ru, const char *comm) {
+    account_reaped_at(pid, status, now_us(), ru, comm);
+}
 
 // --- Signal Handler para la cosecha automática ---
 
 void sigchld_handler(int /*sig*/) {
     int status;
     pid_t pid;
-    int reaped_count = 0;
-
-    // Bloquear para asegurar que waitpid() y la actualización de estadísticas sean atómicas
-    pthread_mutex_lock(&stats_mutex);
+    struct rusage ru;
+    char comm[ZOMBIE_USAGE_COMM_LEN];
+    int saved_errno = errno;
 
-    // Bucle para cosechar a todos los hijos terminados (previene race conditions)
-    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
-        reaped_count++;
+    // Bucle para cosechar a todos los hijos terminados (previene race conditions).
+    // Las estadísticas son atómicas: no se toma ningún mutex en contexto de señal.
+    while ((pid = reap_any(&status, &ru, comm)) > 0) {
+        account_reaped(pid, status, &ru, comm);
         // No usar printf/fprintf aquí. El registro debe hacerse de manera segura.
     }
-    
-    // Actualizar estadísticas
-    stats.zombies_reaped += reaped_count;
-    stats.zombies_active = stats.zombies_created - stats.zombies_reaped;
 
-    pthread_mutex_unlock(&stats_mutex);
+    errno = saved_errno;
+}
+
+// --- Backend pidfd + epoll ---
+
+static int pidfd_open(pid_t pid, unsigned int flags) {
+    return (int) syscall(SYS_pidfd_open, pid, flags);
+}
+
+// El pid y el descriptor viajan empaquetados en epoll_data (fd en los 32 bits altos)
+static uint64_t pidfd_pack(pid_t pid, int fd) {
+    return ((uint64_t)(uint32_t) fd << 32) | (uint32_t) pid;
+}
+
+/**
+ * @brief Cosecha un hijo concreto cuyo pidfd se volvió legible y cierra el pidfd.
+ * @param cb Callback opcional (modo ZOMBIE_BACKEND_POLLED) que recibe la salida.
+ * @return 1 si el hijo fue cosechado, 0 si sigue vivo.
+ */
+static int pidfd_reap_one(uint64_t packed, zombie_event_cb cb, void *arg) {
+    pid_t pid = (pid_t)(uint32_t) packed;
+    int fd = (int)(packed >> 32);
+    int status;
+    struct rusage ru;
+    char comm[ZOMBIE_USAGE_COMM_LEN];
+    pid_t ret;
+
+    // El pidfd está listo: el hijo es zombie y su comm todavía puede leerse
+    child_comm(pid, comm);
+    do {
+        ret = wait4(pid, &status, WNOHANG, &ru);
+    } while (ret == -1 && errno == EINTR);
+
+    // ret == 0 sería un despertar espurio: el hijo sigue vivo y el pidfd se conserva
+    if (ret == 0) return 0;
+
+    // Los hijos creados después heredan copias del pidfd, así que close() por sí solo
+    // no lo sacaría del epoll: se elimina explícitamente antes de cerrarlo.
+    epoll_ctl(pidfd_epoll, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+
+    // ret == pid, o ECHILD (alguien más lo cosechó): en ambos casos ya no es zombie
+    if (ret != pid) {
+        status = -1;
+        memset(&ru, 0, sizeof(ru));
+    }
+    account_reaped(pid, status, ret == pid ? &ru : NULL, comm);
+    if (cb) cb(pid, status, &ru, arg);
+    return 1;
+}
+
+/**
+ * @brief Sondea con WNOHANG a los hijos que no pudieron obtener un pidfd.
+ * @return Número de hijos cosechados.
+ */
+static int pidfd_reap_overflow(zombie_event_cb cb, void *arg) {
+    int reaped = 0;
+    pthread_mutex_lock(&overflow_mutex);
+    for (int i = 0; i < overflow_count; ) {
+        int status;
+        struct rusage ru;
+        char comm[ZOMBIE_USAGE_COMM_LEN];
+        pid_t pid = overflow_pids[i];
+        siginfo_t info;
+        info.si_pid = 0;
+        // Solo se lee el comm de los que ya terminaron (WNOWAIT no los cosecha)
+        if (waitid(P_PID, (id_t) pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == 0) {
+            i++;
+            continue;
+        }
+        child_comm(pid, comm);
+        pid_t ret = wait4(pid, &status, WNOHANG, &ru);
+        if (ret == 0 || (ret == -1 && errno == EINTR)) {
+            i++;
+            continue;
+        }
+        overflow_pids[i] = overflow_pids[--overflow_count];
+        if (ret != pid) {
+            status = -1;
+            memset(&ru, 0, sizeof(ru));
+        }
+        account_reaped(pid, status, ret == pid ? &ru : NULL, comm);
+        if (cb) cb(pid, status, &ru, arg);
+        reaped++;
+    }
+    pthread_mutex_unlock(&overflow_mutex);
+    return reaped;
+}
+
+/**
+ * @brief Hilo cosechador: epoll_wait() informa exactamente qué hijos terminaron.
+ */
+static void *pidfd_reaper_thread(void *arg) {
+    (void) arg;
+    struct epoll_event events[PIDFD_MAX_EVENTS];
+
+    for (;;) {
+        // Solo se usa un timeout si hay hijos sin pidfd que requieren sondeo
+        pthread_mutex_lock(&overflow_mutex);
+        int timeout = overflow_count > 0 ? PIDFD_POLL_MS : -1;
+        pthread_mutex_unlock(&overflow_mutex);
+
+        int n = epoll_wait(pidfd_epoll, events, PIDFD_MAX_EVENTS, timeout);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait ZOMBIE_PIDFD");
+            return NULL;
+        }
+
+        for (int i = 0; i < n; i++) {
+            pidfd_reap_one(events[i].data.u64, NULL, NULL);
+        }
+        if (timeout != -1) {
+            pidfd_reap_overflow(NULL, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Registra un hijo recién creado en el conjunto epoll del backend pidfd.
+ */
+static void pidfd_watch_child(pid_t pid) {
+    // pidfd_open funciona aunque el hijo ya haya terminado (sigue siendo zombie
+    // hasta que lo cosechemos), así que no existe carrera con la salida del hijo.
+    int fd = pidfd_open(pid, 0);
+    if (fd != -1) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = pidfd_pack(pid, fd);
+        if (epoll_ctl(pidfd_epoll, EPOLL_CTL_ADD, fd, &ev) == 0) {
+            return;
+        }
+        close(fd);
+    }
+
+    // Sin descriptores disponibles (EMFILE/ENFILE): se vigila por sondeo
+    pthread_mutex_lock(&overflow_mutex);
+    if (overflow_count < PIDFD_OVERFLOW_MAX) {
+        overflow_pids[overflow_count++] = pid;
+    } else {
+        fprintf(stderr, "zombie: sin pidfd ni espacio de sondeo para el PID %d\n", pid);
+    }
+    pthread_mutex_unlock(&overflow_mutex);
+}
+
+/**
+ * @brief Crea el conjunto epoll y, si se pide, el hilo cosechador del backend pidfd.
+ * @param with_thread 0 en modo ZOMBIE_BACKEND_POLLED: la aplicación drena el epoll.
+ */
+static int pidfd_backend_start(int with_thread) {
+    // Comprobar que el kernel soporta pidfd_open (Linux >= 5.3)
+    int probe = pidfd_open(getpid(), 0);
+    if (probe == -1) {
+        return -1;
+    }
+    close(probe);
+
+    // Cada hijo vivo consume un descriptor: subir el límite blando al máximo permitido
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    pidfd_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (pidfd_epoll == -1) {
+        return -1;
+    }
+
+    if (with_thread) {
+        int err = pthread_create(&pidfd_thread, NULL, pidfd_reaper_thread, NULL);
+        if (err != 0) {
+            close(pidfd_epoll);
+            pidfd_epoll = -1;
+            errno = err;
+            return -1;
+        }
+        pthread_detach(pidfd_thread);
+    }
+    pidfd_owner = getpid();
+
+    return 0;
+}
+
+// --- Backend signalfd (hilo cosechador dedicado) ---
+
+/**
+ * @brief Hilo cosechador: lee SIGCHLD del signalfd y cosecha por lotes.
+ * Varias señales pendientes se fusionan en una sola, así que cada lectura va
+ * seguida de un bucle de wait4(WNOHANG) que vacía todos los hijos terminados.
+ */
+static void *signalfd_reaper_thread(void *arg) {
+    (void) arg;
+    struct signalfd_siginfo info[SIGNALFD_BATCH];
+
+    for (;;) {
+        ssize_t n = read(sigchld_fd, info, sizeof(info));
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("read ZOMBIE_SIGNALFD");
+            return NULL;
+        }
+
+        int status;
+        pid_t pid;
+        struct rusage ru;
+        char comm[ZOMBIE_USAGE_COMM_LEN];
+        while ((pid = reap_any(&status, &ru, comm)) > 0) {
+            account_reaped(pid, status, &ru, comm);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Bloquea SIGCHLD, crea el signalfd y lanza el hilo cosechador.
+ */
+static int signalfd_backend_start(void) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+
+    // Los hilos creados a partir de aquí (incluido el cosechador) heredan la máscara
+    int err = pthread_sigmask(SIG_BLOCK, &mask, &saved_sigmask);
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+
+    sigchld_fd = signalfd(-1, &mask, SFD_CLOEXEC);
+    if (sigchld_fd == -1) {
+        pthread_sigmask(SIG_SETMASK, &saved_sigmask, NULL);
+        return -1;
+    }
+
+    err = pthread_create(&signalfd_thread, NULL, signalfd_reaper_thread, NULL);
+    if (err != 0) {
+        close(sigchld_fd);
+        sigchld_fd = -1;
+        pthread_sigmask(SIG_SETMASK, &saved_sigmask, NULL);
+        errno = err;
+        return -1;
+    }
+    pthread_detach(signalfd_thread);
+
+    return 0;
+}
+
+// --- Lanzamiento vía posix_spawn (común al camino local y al servidor de spawn) ---
+
+/**
+ * @brief Traduce las acciones sobre descriptores al formato de posix_spawn.
+ * @return 0 en éxito, o un código de error (posix_spawn no usa errno).
+ */
+static int build_file_actions(posix_spawn_file_actions_t *fa_out,
+                              const zombie_file_action_t *actions, int count) {
+    int err = posix_spawn_file_actions_init(fa_out);
+    for (int i = 0; err == 0 && i < count; i++) {
+        const zombie_file_action_t *fa = &actions[i];
+        switch (fa->type) {
+            case ZOMBIE_FA_OPEN:
+                err = posix_spawn_file_actions_addopen(fa_out, fa->fd, fa->path, fa->oflag, fa->mode);
+                break;
+            case ZOMBIE_FA_DUP2:
+                err = posix_spawn_file_actions_adddup2(fa_out, fa->src_fd, fa->fd);
+                break;
+            case ZOMBIE_FA_CLOSE:
+                err = posix_spawn_file_actions_addclose(fa_out, fa->fd);
+                break;
+            default:
+                err = EINVAL;
+        }
+    }
+    return err;
+}
+
+// --- Servidor de spawn (zygote) ---
+// El auxiliar se crea con fork() mientras el padre todavía es pequeño; después,
+// cada spawn viaja como mensaje por un socketpair SOCK_SEQPACKET y el auxiliar hace
+// el posix_spawn, cosecha a sus hijos y reporta las salidas por lotes. El coste del
+// spawn deja de depender del tamaño que alcance el proceso que llama.
+
+// Acción sobre descriptores serializada (DUP2 referencia un fd recibido por SCM_RIGHTS)
+typedef struct {
+    int32_t type;
+    int32_t fd;
+    int32_t src_index;
+    int32_t oflag;
+    uint32_t mode;
+} zygote_action_t;
+
+// Cabecera de solicitud; le siguen las acciones y las cadenas terminadas en '\0'
+// (comando, argv, entorno y las rutas de las acciones OPEN, en ese orden)
+typedef struct {
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t n_actions;
+    uint32_t n_fds;
+} zygote_req_t;
+
+typedef struct {
+    int32_t pid;
+    int32_t err;
+} zygote_reply_t;
+
+typedef struct {
+    int32_t pid;
+    int32_t status;
+    uint64_t exit_us;
+    struct rusage usage;
+    char comm[ZOMBIE_USAGE_COMM_LEN];
+} zygote_exit_t;
+
+/**
+ * @brief Lee la siguiente cadena del mensaje; NULL si el mensaje está truncado.
+ */
+static char *zygote_next_str(char **cursor, char *end) {
+    char *str = *cursor;
+    char *nul = memchr(str, '\0', (size_t)(end - str));
+    if (!nul) return NULL;
+    *cursor = nul + 1;
+    return str;
+}
+
+/**
+ * @brief Atiende una solicitud en el auxiliar: decodifica, lanza y responde el pid.
+ */
+static void zygote_handle_request(int req_fd, char *buf, const sigset_t *child_mask) {
+    char cmsg_buf[CMSG_SPACE(sizeof(int) * ZYGOTE_MAX_FDS)];
+    struct iovec iov = {buf, ZYGOTE_MSG_MAX};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsg_buf;
+    msg.msg_controllen = sizeof(cmsg_buf);
+
+    ssize_t len = recvmsg(req_fd, &msg, MSG_CMSG_CLOEXEC);
+    if (len <= 0) {
+        if (len == 0 || errno != EINTR) _exit(0); // El padre cerró el canal
+        return;
+    }
+
+    int fds[ZYGOTE_MAX_FDS];
+    int n_fds = 0;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+            n_fds = (int)((c->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            memcpy(fds, CMSG_DATA(c), sizeof(int) * n_fds);
+        }
+    }
+
+    zygote_reply_t reply = {-1, EINVAL};
+    char *end = buf + len;
+    zygote_req_t *req = (zygote_req_t *) buf;
+    zygote_action_t *wire = (zygote_action_t *)(req + 1);
+    // n_actions viene del otro extremo: se valida contra len antes de calcular punteros
+    int valid = len >= (ssize_t) sizeof(*req) && req->n_actions <= ZYGOTE_MAX_FDS * 4 &&
+                (size_t) len - sizeof(*req) >= req->n_actions * sizeof(*wire) &&
+                req->argc < ZYGOTE_MSG_MAX / 2 && req->envc < ZYGOTE_MSG_MAX / 2;
+
+    if (valid) {
+        char *cursor = (char *)(wire + req->n_actions);
+        char *argv[req->argc + 1];
+        char *envp[req->envc + 1];
+        zombie_file_action_t actions[req->n_actions + 1];
+        char *command = zygote_next_str(&cursor, end);
+        int ok = command != NULL;
+
+        for (uint32_t i = 0; ok && i < req->argc; i++) ok = (argv[i] = zygote_next_str(&cursor, end)) != NULL;
+        for (uint32_t i = 0; ok && i < req->envc; i++) ok = (envp[i] = zygote_next_str(&cursor, end)) != NULL;
+        for (uint32_t i = 0; ok && i < req->n_actions; i++) {
+            actions[i].type = (zombie_file_action_type_t) wire[i].type;
+            actions[i].fd = wire[i].fd;
+            actions[i].oflag = wire[i].oflag;
+            actions[i].mode = (mode_t) wire[i].mode;
+            actions[i].path = NULL;
+            actions[i].src_fd = -1;
+            if (wire[i].type == ZOMBIE_FA_OPEN) {
+                ok = (actions[i].path = zygote_next_str(&cursor, end)) != NULL;
+            } else if (wire[i].type == ZOMBIE_FA_DUP2) {
+                ok = wire[i].src_index >= 0 && wire[i].src_index < n_fds;
+                if (ok) actions[i].src_fd = fds[wire[i].src_index];
+            }
+        }
+
+        if (ok) {
+            argv[req->argc] = NULL;
+            envp[req->envc] = NULL;
+
+            posix_spawn_file_actions_t fa;
+            posix_spawnattr_t attr;
+            sigset_t sigchld;
+            sigemptyset(&sigchld);
+            sigaddset(&sigchld, SIGCHLD);
+
+            reply.err = build_file_actions(&fa, actions, (int) req->n_actions);
+            if (reply.err == 0) {
+                // El auxiliar bloquea SIGCHLD: sus hijos deben partir con la máscara original
+                posix_spawnattr_init(&attr);
+                posix_spawnattr_setsigmask(&attr, child_mask);
+                posix_spawnattr_setsigdefault(&attr, &sigchld);
+                posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+                pid_t pid;
+                reply.err = posix_spawn(&pid, command, &fa, &attr, argv, envp);
+                if (reply.err == 0) reply.pid = pid;
+                posix_spawnattr_destroy(&attr);
+            }
+            posix_spawn_file_actions_destroy(&fa);
+        }
+    }
+
+    for (int i = 0; i < n_fds; i++) close(fds[i]);
+    send(req_fd, &reply, sizeof(reply), MSG_NOSIGNAL);
+}
+
+/**
+ * @brief Cosecha a todos los hijos terminados del auxiliar y los reporta por lotes.
+ */
+static void zygote_report_exits(int evt_fd) {
+    static zygote_exit_t batch[ZYGOTE_EXIT_BATCH];
+    int n = 0;
+    int status;
+    pid_t pid;
+
+    // El rusage y el comm viajan con cada salida: la contabilidad se hace en el padre
+    while ((pid = reap_any(&status, &batch[n].usage, batch[n].comm)) > 0) {
+        batch[n].pid = pid;
+        batch[n].status = status;
+        batch[n].exit_us = now_us();
+        if (++n == ZYGOTE_EXIT_BATCH) {
+            send(evt_fd, batch, sizeof(batch[0]) * n, MSG_NOSIGNAL);
+            n = 0;
+        }
+    }
+    if (n > 0) {
+        send(evt_fd, batch, sizeof(batch[0]) * n, MSG_NOSIGNAL);
+    }
+}
+
+/**
+ * @brief Bucle del proceso auxiliar: nunca retorna.
+ */
+static void zygote_main(int req_fd, int evt_fd, const sigset_t *child_mask) {
+    static char buf[ZYGOTE_MSG_MAX];
+
+    // Si el padre muere, el auxiliar no debe quedar huérfano esperando solicitudes
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    int sfd = signalfd(-1, &mask, SFD_CLOEXEC);
+    if (sfd == -1) _exit(EXIT_FAILURE);
+
+    struct pollfd pfd[2] = {{req_fd, POLLIN, 0}, {sfd, POLLIN, 0}};
+    for (;;) {
+        if (poll(pfd, 2, -1) == -1) {
+            if (errno == EINTR) continue;
+            _exit(EXIT_FAILURE);
+        }
+        if (pfd[1].revents & POLLIN) {
+            struct signalfd_siginfo info[SIGNALFD_BATCH];
+            if (read(sfd, info, sizeof(info)) > 0) {
+                zygote_report_exits(evt_fd);
+            }
+        }
+        if (pfd[0].revents & (POLLIN | POLLHUP)) {
+            zygote_handle_request(req_fd, buf, child_mask);
+        }
+    }
+}
+
+/**
+ * @brief Hilo del padre que recibe los lotes de salidas y los aplica al registro.
+ */
+static void *zygote_reader_thread(void *arg) {
+    (void) arg;
+    static zygote_exit_t batch[ZYGOTE_EXIT_BATCH]; // Un único hilo lector
+
+    for (;;) {
+        ssize_t len = recv(zygote_evt_fd, batch, sizeof(batch), 0);
+        if (len == -1 && errno == EINTR) continue;
+        if (len <= 0) break;
+
+        int n = (int)(len / (ssize_t) sizeof(batch[0]));
+        for (int i = 0; i < n; i++) {
+            account_reaped_at(batch[i].pid, batch[i].status, batch[i].exit_us, &batch[i].usage, batch[i].comm);
+        }
+    }
+
+    // El auxiliar terminó: los spawns vuelven al camino local y se cosecha al auxiliar
+    pthread_mutex_lock(&zygote_mutex);
+    zygote_alive = 0;
+    pthread_mutex_unlock(&zygote_mutex);
+    waitpid(zygote_pid, NULL, 0);
+    return NULL;
+}
+
+/**
+ * @brief Crea el proceso auxiliar y los dos socketpair (solicitudes y salidas).
+ */
+static int zygote_start(void) {
+    int req[2], evt[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, req) == -1) return -1;
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, evt) == -1) {
+        close(req[0]);
+        close(req[1]);
+        return -1;
+    }
+
+    int buf_size = ZYGOTE_SOCK_BUF;
+    for (int i = 0; i < 2; i++) {
+        setsockopt(req[i], SOL_SOCKET, SO_SNDBUF, &buf_size, sizeof(buf_size));
+        setsockopt(evt[i], SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size));
+    }
+
+    // El auxiliar bloquea SIGCHLD antes de existir para no perder ninguna salida
+    sigset_t mask, old_mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    pthread_sigmask(SIG_BLOCK, &mask, &old_mask);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(req[0]);
+        close(evt[0]);
+        zygote_main(req[1], evt[1], &old_mask);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    close(req[1]);
+    close(evt[1]);
+
+    if (pid == -1) {
+        close(req[0]);
+        close(evt[0]);
+        return -1;
+    }
+
+    zygote_req_fd = req[0];
+    zygote_evt_fd = evt[0];
+    zygote_pid = pid;
+    zygote_alive = 1;
+
+    pthread_t reader;
+    int err = pthread_create(&reader, NULL, zygote_reader_thread, NULL);
+    if (err != 0) {
+        // Sin lector no hay cosecha: cerrar el canal termina al auxiliar
+        close(zygote_req_fd);
+        close(zygote_evt_fd);
+        zygote_alive = 0;
+        waitpid(pid, NULL, 0);
+        errno = err;
+        return -1;
+    }
+    pthread_detach(reader);
+    return 0;
+}
+
+/**
+ * @brief Añade una cadena (con su '\0') al mensaje en construcción.
+ */
+static int zygote_put_str(char *buf, size_t *off, const char *str) {
+    size_t len = strlen(str) + 1;
+    if (*off + len > ZYGOTE_MSG_MAX) return -1;
+    memcpy(buf + *off, str, len);
+    *off += len;
+    return 0;
+}
+
+/**
+ * @brief Envía una solicitud de spawn al auxiliar y espera el pid asignado.
+ */
+static pid_t spawn_via_server(const char *command, char *const argv[], char *const envp[],
+                              const zombie_file_action_t *actions, int n_actions) {
+    static char buf[ZYGOTE_MSG_MAX]; // Protegido por zygote_mutex
+    int fds[ZYGOTE_MAX_FDS];
+    zygote_req_t req = {0, 0, (uint32_t) n_actions, 0};
+
+    if (n_actions < 0 || n_actions > ZYGOTE_MAX_FDS * 4) {
+        errno = EINVAL;
+        return -1;
+    }
+    while (argv[req.argc]) req.argc++;
+    while (envp[req.envc]) req.envc++;
+
+    pthread_mutex_lock(&zygote_mutex);
+    if (!zygote_alive) {
+        pthread_mutex_unlock(&zygote_mutex);
+        errno = EPIPE;
+        return -1;
+    }
+
+    size_t off = sizeof(req) + sizeof(zygote_action_t) * n_actions;
+    int err = off > ZYGOTE_MSG_MAX || zygote_put_str(buf, &off, command) == -1;
+    for (uint32_t i = 0; !err && i < req.argc; i++) err = zygote_put_str(buf, &off, argv[i]) == -1;
+    for (uint32_t i = 0; !err && i < req.envc; i++) err = zygote_put_str(buf, &off, envp[i]) == -1;
+    for (int i = 0; !err && i < n_actions; i++) {
+        zygote_action_t *wire = (zygote_action_t *)(buf + sizeof(req)) + i;
+        wire->type = actions[i].type;
+        wire->fd = actions[i].fd;
+        wire->oflag = actions[i].oflag;
+        wire->mode = actions[i].mode;
+        wire->src_index = -1;
+        if (actions[i].type == ZOMBIE_FA_OPEN) {
+            err = zygote_put_str(buf, &off, actions[i].path) == -1;
+        } else if (actions[i].type == ZOMBIE_FA_DUP2) {
+            err = req.n_fds == ZYGOTE_MAX_FDS;
+            if (!err) {
+                wire->src_index = (int32_t) req.n_fds;
+                fds[req.n_fds++] = actions[i].src_fd;
+            }
+        }
+    }
+    if (err) {
+        pthread_mutex_unlock(&zygote_mutex);
+        errno = E2BIG;
+        return -1;
+    }
+    memcpy(buf, &req, sizeof(req));
+
+    char cmsg_buf[CMSG_SPACE(sizeof(int) * ZYGOTE_MAX_FDS)];
+    struct iovec iov = {buf, off};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (req.n_fds > 0) {
+        memset(cmsg_buf, 0, sizeof(cmsg_buf));
+        msg.msg_control = cmsg_buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * req.n_fds);
+        struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(int) * req.n_fds);
+        memcpy(CMSG_DATA(c), fds, sizeof(int) * req.n_fds);
+    }
+
+    uint64_t spawn_us = now_us();
+    zygote_reply_t reply = {-1, EPIPE};
+    ssize_t sent;
+    do {
+        sent = sendmsg(zygote_req_fd, &msg, MSG_NOSIGNAL);
+    } while (sent == -1 && errno == EINTR);
+
+    if (sent != -1) {
+        ssize_t got;
+        do {
+            got = recv(zygote_req_fd, &reply, sizeof(reply), 0);
+        } while (got == -1 && errno == EINTR);
+        if (got != (ssize_t) sizeof(reply)) {
+            reply.pid = -1;
+            reply.err = EPIPE;
+        }
+    }
+    pthread_mutex_unlock(&zygote_mutex);
+
+    if (reply.pid <= 0) {
+        errno = reply.err;
+        return -1;
+    }
+
+    // El auxiliar es quien lo cosecha: aquí solo se contabiliza y se registra
+    account_created(reply.pid, spawn_us);
+    return reply.pid;
 }
 
 // --- API de la Librería ---
 
 void zombie_init(void) {
-    struct sigaction sa;
+    if (zombie_init_backend(ZOMBIE_BACKEND_SIGNAL) == -1) {
+        perror("sigaction ZOMBIE_INIT");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int zombie_init_backend(zombie_backend_t backend) {
+    if (backend == ZOMBIE_BACKEND_PIDFD || backend == ZOMBIE_BACKEND_POLLED) {
+        if (pidfd_epoll != -1) {
+            // Ya inicializado: el modo (con o sin hilo) no puede cambiarse después
+            if (backend == active_backend) return 0;
+            errno = EBUSY;
+            return -1;
+        }
+        if (pidfd_backend_start(backend == ZOMBIE_BACKEND_PIDFD) == -1) return -1;
+        active_backend = backend;
+        return 0;
+    }
 
-    // 1. Inicializar Mutex (aunque PTHREAD_MUTEX_INITIALIZER lo hizo)
-    // pthread_mutex_init(&stats_mutex, NULL); 
+    if (backend == ZOMBIE_BACKEND_SIGNALFD) {
+        if (sigchld_fd != -1) return 0; // Ya inicializado
+        if (signalfd_backend_start() == -1) return -1;
+        active_backend = ZOMBIE_BACKEND_SIGNALFD;
+        return 0;
+    }
+
+    if (backend != ZOMBIE_BACKEND_SIGNAL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct sigaction sa;
 
-    // 2. Configurar el SIGCHLD Handler
+    // Configurar el SIGCHLD Handler
     sa.sa_handler = sigchld_handler;
     sigemptyset(&sa.sa_mask);
     // SA_RESTART: para reanudar llamadas al sistema interrumpidas por la señal
-    sa.sa_flags = SA_RESTART; 
+    sa.sa_flags = SA_RESTART;
 
     if (sigaction(SIGCHLD, &sa, NULL) == -1) {
-        perror("sigaction ZOMBIE_INIT");
-        exit(EXIT_FAILURE);
+        return -1;
+    }
+
+    active_backend = ZOMBIE_BACKEND_SIGNAL;
+    return 0;
+}
+
+int zombie_init_threaded(void) {
+    return zombie_init_backend(ZOMBIE_BACKEND_SIGNALFD);
+}
+
+int zombie_get_fd(void) {
+    if (active_backend != ZOMBIE_BACKEND_POLLED || getpid() != pidfd_owner) {
+        errno = EINVAL;
+        return -1;
+    }
+    return pidfd_epoll;
+}
+
+int zombie_process_events(zombie_event_cb cb, void *arg) {
+    if (active_backend != ZOMBIE_BACKEND_POLLED || getpid() != pidfd_owner) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct epoll_event events[PIDFD_MAX_EVENTS];
+    int reaped = 0;
+    int n;
+
+    // Drenar sin bloquear: el llamador ya supo por su propio bucle que el fd es legible
+    do {
+        n = epoll_wait(pidfd_epoll, events, PIDFD_MAX_EVENTS, 0);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            reaped += pidfd_reap_one(events[i].data.u64, cb, arg);
+        }
+    } while (n == PIDFD_MAX_EVENTS || (n == -1 && errno == EINTR));
+
+    return reaped + pidfd_reap_overflow(cb, arg);
+}
+
+int zombie_init_spawn_server(zombie_backend_t backend) {
+    // Primero el auxiliar: el backend puede crear hilos, y el fork debe ocurrir antes
+    if (zygote_req_fd == -1 && zygote_start() == -1) {
+        return -1;
+    }
+    return zombie_init_backend(backend);
+}
+
+/**
+ * @brief Contabiliza un hijo recién creado (por fork o posix_spawn) en el padre.
+ */
+static void register_child(pid_t pid, uint64_t fork_us) {
+    // Actualización atómica del conteo de hijos creados
+    account_created(pid, fork_us);
+
+    // Un hijo que a su vez hace fork hereda el epoll pero no el hilo cosechador
+    if ((active_backend == ZOMBIE_BACKEND_PIDFD || active_backend == ZOMBIE_BACKEND_POLLED) &&
+        getpid() == pidfd_owner) {
+        pidfd_watch_child(pid);
     }
 }
 
 pid_t zombie_safe_fork(void) {
+    // El instante se toma antes de fork(): la latencia incluye el propio fork
+    uint64_t fork_us = now_us();
     pid_t pid = fork();
 
-    if (pid > 0) { 
-        // Padre: Bloqueo y actualización de conteo de hijos creados
-        pthread_mutex_lock(&stats_mutex);
-        stats.zombies_created++;
-        stats.zombies_active++;
-        pthread_mutex_unlock(&stats_mutex);
-    } 
+    if (pid == 0 && active_backend == ZOMBIE_BACKEND_SIGNALFD) {
+        // La máscara sobrevive a exec: el hijo no debe heredar SIGCHLD bloqueado
+        pthread_sigmask(SIG_SETMASK, &saved_sigmask, NULL);
+    }
+
+    if (pid > 0) {
+        register_child(pid, fork_us);
+    }
     // Si pid == 0 (Hijo) o pid < 0 (Error), no se actualizan las estadísticas.
 
     return pid;
 }
 
-int zombie_safe_spawn(const char *command, char *args[]) {
+/**
+ * @brief Aplica las acciones sobre descriptores en el hijo del camino fork().
+ * @return 0 en éxito, -1 en error (errno indica la causa).
+ */
+static int apply_file_actions(const zombie_file_action_t *actions, int count) {
+    for (int i = 0; i < count; i++) {
+        const zombie_file_action_t *fa = &actions[i];
+        switch (fa->type) {
+            case ZOMBIE_FA_OPEN: {
+                int fd = open(fa->path, fa->oflag, fa->mode);
+                if (fd == -1) return -1;
+                if (fd != fa->fd) {
+                    if (dup2(fd, fa->fd) == -1) return -1;
+                    close(fd);
+                }
+                break;
+            }
+            case ZOMBIE_FA_DUP2:
+                if (dup2(fa->src_fd, fa->fd) == -1) return -1;
+                break;
+            case ZOMBIE_FA_CLOSE:
+                close(fa->fd);
+                break;
+            default:
+                errno = EINVAL;
+                return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Camino posix_spawn: glibc lo implementa con clone(CLONE_VM | CLONE_VFORK),
+ * así que no se copian las tablas de páginas del padre y el coste no crece con su RSS.
+ */
+static pid_t spawn_posix(const char *command, char *const argv[], char *const envp[],
+                         const zombie_file_action_t *actions, int n_actions) {
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_t attr;
+    pid_t pid;
+
+    int err = build_file_actions(&fa, actions, n_actions);
+    if (err != 0) {
+        posix_spawn_file_actions_destroy(&fa);
+        errno = err;
+        return -1;
+    }
+
+    posix_spawnattr_init(&attr);
+    if (active_backend == ZOMBIE_BACKEND_SIGNALFD) {
+        // Igual que en zombie_safe_fork: el hijo no hereda SIGCHLD bloqueado
+        posix_spawnattr_setsigmask(&attr, &saved_sigmask);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+    }
+
+    uint64_t fork_us = now_us();
+    err = posix_spawn(&pid, command, &fa, &attr, argv, envp);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&fa);
+
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+
+    register_child(pid, fork_us);
+    return pid;
+}
+
+pid_t zombie_spawn_ex(const char *command, char *const argv[], const zombie_spawn_opts_t *opts) {
+    zombie_spawn_opts_t defaults = {ZOMBIE_SPAWN_POSIX, NULL, NULL, 0};
+    if (!opts) opts = &defaults;
+
+    char *const *envp = opts->envp ? opts->envp : environ;
+
+    if (opts->method == ZOMBIE_SPAWN_SERVER) {
+        return spawn_via_server(command, argv, envp, opts->file_actions, opts->n_file_actions);
+    }
+
+    if (opts->method == ZOMBIE_SPAWN_POSIX) {
+        return spawn_posix(command, argv, envp, opts->file_actions, opts->n_file_actions);
+    }
+
+    if (opts->method != ZOMBIE_SPAWN_FORK) {
+        errno = EINVAL;
+        return -1;
+    }
+
     pid_t pid = zombie_safe_fork(); // Utiliza la función segura con actualización de estadísticas
+    if (pid == 0) {
+        // Hijo: aplica las acciones sobre descriptores y ejecuta el comando
+        if (apply_file_actions(opts->file_actions, opts->n_file_actions) == 0) {
+            execve(command, argv, envp);
+        }
+        // Si execve retorna, ha fallado. _exit evita vaciar los buffers stdio del padre.
+        perror("zombie_spawn_ex execve");
+        _exit(127);
+    }
+
+    return pid;
+}
+
+int zombie_safe_spawn(const char *command, char *args[]) {
+    // Camino rápido: el servidor de spawn si está activo; si no, posix_spawn,
+    // que evita copiar el espacio de direcciones del padre
+    zombie_spawn_opts_t opts = {ZOMBIE_SPAWN_POSIX, NULL, NULL, 0};
+    if (__atomic_load_n(&zygote_alive, __ATOMIC_ACQUIRE)) {
+        opts.method = ZOMBIE_SPAWN_SERVER;
+    }
+
+    pid_t pid = zombie_spawn_ex(command, args, &opts);
+    if (pid == -1 && opts.method == ZOMBIE_SPAWN_SERVER && errno == EPIPE) {
+        opts.method = ZOMBIE_SPAWN_POSIX; // El auxiliar murió: camino local
+        pid = zombie_spawn_ex(command, args, &opts);
+    }
 
     if (pid == -1) {
-        perror("zombie_safe_spawn fork");
+        perror("zombie_safe_spawn");
         return -1;
     }
 
-    if (pid == 0) {
-        // Hijo: Ejecuta el comando
-        execv(command, args);
-        // Si execv retorna, ha fallado.
-        perror("zombie_safe_spawn execv");
-        exit(EXIT_FAILURE); 
-    }
-    
-    // Padre: Simplemente retorna. El reaprocesamiento es manejado por el SIGCHLD handler.
+    // Padre: Simplemente retorna. El reaprocesamiento es manejado por el backend activo.
     return 0;
 }
 
 void zombie_get_stats(zombie_stats_t *stats_out) {
     if (!stats_out) return;
 
-    // Bloquear y copiar las estadísticas de forma segura
-    pthread_mutex_lock(&stats_mutex);
-    memcpy(stats_out, &stats, sizeof(zombie_stats_t));
-    pthread_mutex_unlock(&stats_mutex);
+    // Un hijo puede cosecharse (handler o hilo cosechador) antes de que el padre vuelva
+    // de fork() y cuente su creación: durante esa ventana reaped puede superar a created.
+    // Se lee primero 'reaped' y zombies_active se acota en 0.
+    uint64_t reaped = __atomic_load_n(&counters.reaped, __ATOMIC_ACQUIRE);
+    uint64_t created = __atomic_load_n(&counters.created, __ATOMIC_ACQUIRE);
+
+    stats_out->zombies_created = (long long) created;
+    stats_out->zombies_reaped = (long long) reaped;
+    stats_out->zombies_active = created > reaped ? (long long) (created - reaped) : 0;
+}
+
+/**
+ * @brief Cota superior (en µs) del percentil `pct` según los buckets del histograma.
+ */
+static long long latency_percentile(const long long *buckets, long long total, int pct) {
+    if (total == 0) return 0;
+
+    long long rank = (total * pct + 99) / 100; // ceil(total * pct / 100)
+    long long seen = 0;
+    for (int i = 0; i < ZOMBIE_LATENCY_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return (2LL << i) - 1;
+        }
+    }
+    return (2LL << (ZOMBIE_LATENCY_BUCKETS - 1)) - 1;
+}
+
+void zombie_get_stats_ex(zombie_stats_ex_t *stats_out) {
+    if (!stats_out) return;
+
+    zombie_get_stats(&stats_out->basic);
+
+    long long total = 0;
+    for (int i = 0; i < ZOMBIE_LATENCY_BUCKETS; i++) {
+        stats_out->latency_buckets[i] =
+            (long long) __atomic_load_n(&latency_buckets[i], __ATOMIC_RELAXED);
+        total += stats_out->latency_buckets[i];
+    }
+
+    long long max = (long long) __atomic_load_n(&latency_max_us, __ATOMIC_RELAXED);
+    long long p50 = latency_percentile(stats_out->latency_buckets, total, 50);
+    long long p99 = latency_percentile(stats_out->latency_buckets, total, 99);
+
+    stats_out->latency_samples = total;
+    stats_out->latency_max_us = max;
+    // La cota del bucket nunca debe superar el máximo observado
+    stats_out->latency_p50_us = p50 < max ? p50 : max;
+    stats_out->latency_p99_us = p99 < max ? p99 : max;
+    stats_out->untracked_children = (long long) __atomic_load_n(&registry_untracked, __ATOMIC_RELAXED);
+}
+
+static void usage_copy(const usage_slot_t *slot, zombie_usage_t *out) {
+    out->children += (long long) __atomic_load_n(&slot->children, __ATOMIC_RELAXED);
+    out->utime_us += (long long) __atomic_load_n(&slot->utime_us, __ATOMIC_RELAXED);
+    out->stime_us += (long long) __atomic_load_n(&slot->stime_us, __ATOMIC_RELAXED);
+    out->minflt += (long long) __atomic_load_n(&slot->minflt, __ATOMIC_RELAXED);
+    out->majflt += (long long) __atomic_load_n(&slot->majflt, __ATOMIC_RELAXED);
+    out->nvcsw += (long long) __atomic_load_n(&slot->nvcsw, __ATOMIC_RELAXED);
+    out->nivcsw += (long long) __atomic_load_n(&slot->nivcsw, __ATOMIC_RELAXED);
+    long long rss = (long long) __atomic_load_n(&slot->maxrss_kb, __ATOMIC_RELAXED);
+    if (rss > out->maxrss_kb) out->maxrss_kb = rss;
+}
+
+static int compare_usage_cpu(const void *a, const void *b) {
+    const zombie_usage_t *x = a, *y = b;
+    long long cx = x->utime_us + x->stime_us, cy = y->utime_us + y->stime_us;
+    return (cy > cx) - (cy < cx);
+}
+
+int zombie_get_usage(zombie_usage_t *usage, int max) {
+    zombie_usage_t rows[USAGE_SLOTS + 1];
+    int n = 0;
+
+    if (!usage || max < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (int i = 0; i < USAGE_SLOTS; i++) {
+        const usage_slot_t *slot = &usage_table[i];
+        if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != USAGE_READY) continue;
+
+        // Un comando puede ocupar dos ranuras (ver usage_slot): se fusionan aquí
+        int row = 0;
+        while (row < n && strncmp(rows[row].command, slot->command, ZOMBIE_USAGE_COMM_LEN) != 0) row++;
+        if (row == n) {
+            memset(&rows[n], 0, sizeof(rows[n]));
+            memcpy(rows[n].command, slot->command, ZOMBIE_USAGE_COMM_LEN);
+            n++;
+        }
+        usage_copy(slot, &rows[row]);
+    }
+    if (__atomic_load_n(&usage_other.children, __ATOMIC_RELAXED) > 0) {
+        memset(&rows[n], 0, sizeof(rows[n]));
+        memcpy(rows[n].command, usage_other.command, ZOMBIE_USAGE_COMM_LEN);
+        usage_copy(&usage_other, &rows[n++]);
+    }
+
+    qsort(rows, (size_t) n, sizeof(rows[0]), compare_usage_cpu);
+    if (n > max) n = max;
+    memcpy(usage, rows, sizeof(rows[0]) * (size_t) n);
+    return n;
+}
+
+int zombie_get_child_status(pid_t pid, zombie_child_status_t *status) {
+    zombie_child_status_t tmp;
+    uint64_t key;
+
+    if (!registry_lookup(pid, &key, status ? status : &tmp)) {
+        errno = ESRCH;
+        return -1;
+    }
+    return 0;
+}
+
+int zombie_wait_child(pid_t pid, int timeout_ms, zombie_child_status_t *status) {
+    zombie_child_status_t tmp;
+    zombie_child_status_t *out = status ? status : &tmp;
+    uint64_t deadline = timeout_ms >= 0 ? now_us() + (uint64_t) timeout_ms * 1000 : 0;
+
+    for (;;) {
+        uint64_t key;
+        child_slot_t *slot = registry_lookup(pid, &key, out);
+        if (!slot) {
+            errno = ESRCH;
+            return -1;
+        }
+        if (out->state == ZOMBIE_CHILD_EXITED) return 0;
+
+        // Leer la secuencia y confirmar que la ranura sigue igual antes de dormir:
+        // si el cosechador publica entre medias, el futex no duerme (valor distinto).
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->key, __ATOMIC_ACQUIRE) != key) continue;
+
+        struct timespec rel, *timeout = NULL;
+        if (timeout_ms >= 0) {
+            uint64_t now = now_us();
+            if (now >= deadline) {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+            rel.tv_sec = (time_t)((deadline - now) / 1000000);
+            rel.tv_nsec = (long)((deadline - now) % 1000000) * 1000;
+            timeout = &rel;
+        }
+        futex(&slot->seq, FUTEX_WAIT_PRIVATE, seq, timeout);
+    }
 }
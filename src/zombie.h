@@ -2,22 +2,174 @@
 #define ZOMBIE_H
 
 #include <sys/types.h>
+#include <sys/stat.h> // mode_t para las acciones ZOMBIE_FA_OPEN
+#include <sys/resource.h> // struct rusage para zombie_event_cb
 #include <unistd.h>
 #include <stdlib.h> // Para EXIT_SUCCESS/FAILURE
 
-// Estructura para las estadísticas de zombies
+// Estructura para las estadísticas de zombies (contadores de 64 bits: no desbordan
+// en demonios de larga duración)
 typedef struct {
-    int zombies_created; // Contados al hacer fork
-    int zombies_reaped;  // Contados al llamar a waitpid
-    int zombies_active;  // zombies_created - zombies_reaped
+    long long zombies_created; // Contados al hacer fork
+    long long zombies_reaped;  // Contados al cosechar (wait4)
+    long long zombies_active;  // zombies_created - zombies_reaped, acotado en 0 (un hijo
+                               // puede cosecharse antes de que se cuente su creación)
 } zombie_stats_t;
 
+// Número de buckets del histograma de latencia: el bucket i cubre [2^i, 2^(i+1)) µs
+#define ZOMBIE_LATENCY_BUCKETS 40
+
+// Estadísticas extendidas: incluyen la latencia entre fork y cosecha de cada hijo
+typedef struct {
+    zombie_stats_t basic;
+    long long latency_samples; // Hijos con latencia medida
+    long long latency_p50_us;  // Cota superior del bucket que contiene la mediana
+    long long latency_p99_us;  // Cota superior del bucket que contiene el percentil 99
+    long long latency_max_us;  // Máxima latencia observada
+    long long latency_buckets[ZOMBIE_LATENCY_BUCKETS];
+    long long untracked_children; // Hijos que no cupieron en el registro (sin estado ni latencia)
+} zombie_stats_ex_t;
+
+// Consumo acumulado de los hijos cosechados con un mismo comando (rusage de wait4)
+#define ZOMBIE_USAGE_COMM_LEN 16 // comm del kernel (TASK_COMM_LEN, con '\0')
+#define ZOMBIE_USAGE_MAX 257     // Filas posibles: 256 comandos más "(other)"
+
+typedef struct {
+    char command[ZOMBIE_USAGE_COMM_LEN]; // comm del hijo al terminar (tras exec); "(other)" si la tabla se llenó
+    long long children;  // Hijos cosechados
+    long long utime_us;  // CPU en modo usuario (suma)
+    long long stime_us;  // CPU en modo kernel (suma)
+    long long maxrss_kb; // Máximo ru_maxrss observado
+    long long minflt;    // Fallos de página menores (suma)
+    long long majflt;    // Fallos de página mayores (suma)
+    long long nvcsw;     // Cambios de contexto voluntarios (suma)
+    long long nivcsw;    // Cambios de contexto involuntarios (suma)
+} zombie_usage_t;
+
+// Estado de un hijo en el registro de la librería
+typedef enum {
+    ZOMBIE_CHILD_RUNNING = 1,
+    ZOMBIE_CHILD_EXITED
+} zombie_child_state_t;
+
+typedef struct {
+    pid_t pid;
+    zombie_child_state_t state;
+    long long spawn_time_us; // CLOCK_MONOTONIC en µs (0 si el hijo no fue creado por la librería)
+    long long exit_time_us;  // CLOCK_MONOTONIC en µs (0 mientras sigue corriendo)
+    int exited;              // 1 si terminó con exit()/return
+    int exit_status;         // WEXITSTATUS si exited == 1
+    int term_signal;         // WTERMSIG si terminó por una señal, 0 en otro caso
+    int raw_status;          // Estado crudo de waitpid (-1 si se desconoce)
+} zombie_child_status_t;
+
+// Mecanismo de cosecha seleccionado en la inicialización
+typedef enum {
+    ZOMBIE_BACKEND_SIGNAL = 0, // SIGCHLD handler con waitpid(-1) (comportamiento clásico)
+    ZOMBIE_BACKEND_PIDFD,      // Un pidfd por hijo + epoll, cosechado por un hilo dedicado
+    ZOMBIE_BACKEND_SIGNALFD,   // SIGCHLD bloqueado en todos los hilos y leído por un hilo vía signalfd
+    ZOMBIE_BACKEND_POLLED      // pidfd + epoll sin hilos: la aplicación usa zombie_get_fd/zombie_process_events
+} zombie_backend_t;
+
+/**
+ * @brief Callback de zombie_process_events, invocado una vez por hijo cosechado.
+ * @param pid PID del hijo.
+ * @param status Estado crudo de wait4() (-1 si otro proceso lo cosechó antes).
+ * @param usage Recursos consumidos por el hijo (en ceros si status es -1).
+ * @param arg Puntero opaco pasado a zombie_process_events.
+ */
+typedef void (*zombie_event_cb)(pid_t pid, int status, const struct rusage *usage, void *arg);
+
+// Mecanismo usado por zombie_spawn_ex para crear el hijo
+typedef enum {
+    ZOMBIE_SPAWN_POSIX = 0, // posix_spawn (clone(CLONE_VM|CLONE_VFORK) en glibc): coste independiente del RSS
+    ZOMBIE_SPAWN_FORK,      // fork() + execve(): copia las tablas de páginas del padre
+    ZOMBIE_SPAWN_SERVER     // Delegado al servidor de spawn (ver zombie_init_spawn_server)
+} zombie_spawn_method_t;
+
+// Tipos de acción sobre descriptores aplicadas en el hijo antes del exec
+typedef enum {
+    ZOMBIE_FA_OPEN = 0, // open(path, oflag, mode) sobre el descriptor fd
+    ZOMBIE_FA_DUP2,     // dup2(src_fd, fd)
+    ZOMBIE_FA_CLOSE     // close(fd)
+} zombie_file_action_type_t;
+
+typedef struct {
+    zombie_file_action_type_t type;
+    int fd;           // Descriptor destino en el hijo
+    int src_fd;       // ZOMBIE_FA_DUP2: descriptor origen
+    const char *path; // ZOMBIE_FA_OPEN: ruta a abrir
+    int oflag;        // ZOMBIE_FA_OPEN: flags de open()
+    mode_t mode;      // ZOMBIE_FA_OPEN: permisos si se crea el archivo
+} zombie_file_action_t;
+
+// Opciones de zombie_spawn_ex (NULL equivale a todos los campos en cero)
+typedef struct {
+    zombie_spawn_method_t method;
+    char *const *envp;                        // Entorno del hijo (NULL = heredar environ)
+    const zombie_file_action_t *file_actions; // Aplicadas en orden antes del exec
+    int n_file_actions;
+} zombie_spawn_opts_t;
+
 /**
  * @brief Inicializa la prevención de zombies (configura el SIGCHLD handler).
  * Debe llamarse una vez al inicio del programa.
  */
 void zombie_init(void);
 
+/**
+ * @brief Inicializa la librería con un backend de cosecha específico.
+ * Con ZOMBIE_BACKEND_PIDFD no se instala ningún handler de SIGCHLD: cada hijo
+ * creado por la librería obtiene un pidfd registrado en un epoll, y un hilo
+ * cosechador hace waitpid() solo sobre los hijos que realmente terminaron.
+ * Los hijos que no fueron creados por la librería nunca se cosechan.
+ * @param backend Backend a utilizar.
+ * @return 0 en éxito, -1 en error (errno indica la causa, p.ej. ENOSYS).
+ */
+int zombie_init_backend(zombie_backend_t backend);
+
+/**
+ * @brief Inicializa la librería en modo hilo cosechador (ZOMBIE_BACKEND_SIGNALFD).
+ * Bloquea SIGCHLD y lo consume desde un hilo dedicado que lee un signalfd, de modo
+ * que ningún hilo de la aplicación es interrumpido por la señal (sin EINTR) y las
+ * estadísticas se publican fuera de contexto de señal.
+ * Debe llamarse antes de crear otros hilos: la máscara de señales se hereda, y un
+ * hilo creado antes conservaría SIGCHLD desbloqueado.
+ * @return 0 en éxito, -1 en error (errno indica la causa).
+ */
+int zombie_init_threaded(void);
+
+/**
+ * @brief Arranca el servidor de spawn (zygote) y después inicializa el backend.
+ * Crea con fork() un proceso auxiliar mientras el RSS del padre aún es pequeño.
+ * A partir de ahí zombie_safe_spawn (y zombie_spawn_ex con ZOMBIE_SPAWN_SERVER)
+ * envían cada solicitud (comando, argv, entorno, acciones y descriptores vía
+ * SCM_RIGHTS) al auxiliar, que lanza el hijo, lo cosecha y reporta las salidas
+ * por lotes; el registro y las estadísticas del padre se actualizan igual.
+ * Debe llamarse al inicio del programa, antes de crear hilos.
+ * @param backend Backend para los hijos creados localmente (zombie_safe_fork).
+ * @return 0 en éxito, -1 en error (errno indica la causa).
+ */
+int zombie_init_spawn_server(zombie_backend_t backend);
+
+/**
+ * @brief Devuelve el descriptor de completado del modo ZOMBIE_BACKEND_POLLED.
+ * Es un epoll con un pidfd por hijo: se vuelve legible cuando algún hijo creado
+ * por la librería termina, y puede añadirse al epoll/poll de la aplicación.
+ * La librería no instala handler de SIGCHLD ni crea hilos en este modo.
+ * @return El descriptor, o -1 con errno = EINVAL si el modo no está activo.
+ */
+int zombie_get_fd(void);
+
+/**
+ * @brief Cosecha por lotes, sin bloquear, a los hijos terminados (modo POLLED).
+ * Llama a cb (si no es NULL) con el pid, el estado y el rusage de cada hijo.
+ * Los hijos que no obtuvieron pidfd (sin descriptores libres) no activan el fd;
+ * se sondean en cada llamada.
+ * @return Número de hijos cosechados, o -1 en error (errno indica la causa).
+ */
+int zombie_process_events(zombie_event_cb cb, void *arg);
+
 /**
  * @brief Realiza un fork con prevención de zombies (el padre confía en el handler).
  * @return PID del hijo en el padre, 0 en el hijo, -1 en caso de error.
@@ -26,6 +178,7 @@ pid_t zombie_safe_fork(void);
 
 /**
  * @brief Ejecuta un comando en un proceso hijo con prevención de zombies.
+ * Usa posix_spawn (zombie_spawn_ex con las opciones por defecto).
  * @param command Ruta al ejecutable.
  * @param args Argumentos para el comando.
  * @return 0 en éxito (del padre), -1 en error.
@@ -33,9 +186,127 @@ pid_t zombie_safe_fork(void);
 int zombie_safe_spawn(const char *command, char *args[]);
 
 /**
- * @brief Obtiene las estadísticas de reaprocesamiento de zombies.
+ * @brief Lanza un comando con prevención de zombies y opciones de creación.
+ * El hijo se contabiliza en las estadísticas y lo cosecha el backend activo,
+ * igual que con zombie_safe_fork. Con ZOMBIE_SPAWN_POSIX un fallo de exec se
+ * devuelve como error al padre.
+ * @param command Ruta al ejecutable.
+ * @param argv Argumentos para el comando (terminados en NULL).
+ * @param opts Método, entorno y acciones sobre descriptores (NULL = valores por defecto).
+ * @return PID del hijo, o -1 en error (errno indica la causa).
+ */
+pid_t zombie_spawn_ex(const char *command, char *const argv[], const zombie_spawn_opts_t *opts);
+
+/**
+ * @brief Obtiene las estadísticas de reaprocesamiento de zombies (sin bloqueo).
  * @param stats Puntero a la estructura donde se almacenarán los datos.
  */
 void zombie_get_stats(zombie_stats_t *stats);
 
+/**
+ * @brief Obtiene las estadísticas junto con el histograma de latencia fork -> cosecha.
+ * Todos los contadores son atómicos: ni la lectura ni los forks toman un mutex.
+ * @param stats Puntero a la estructura donde se almacenarán los datos.
+ */
+void zombie_get_stats_ex(zombie_stats_ex_t *stats);
+
+/**
+ * @brief Obtiene el consumo de recursos de los hijos cosechados, agrupado por comando.
+ * Todos los backends cosechan con wait4() y leen el comm del hijo justo antes, así
+ * que cada fila refleja el programa que el hijo ejecutaba al terminar.
+ * @param usage Arreglo destino (ZOMBIE_USAGE_MAX filas bastan siempre).
+ * @param max Capacidad de `usage`.
+ * @return Filas escritas, ordenadas de mayor a menor CPU (usuario + kernel), o -1 en error.
+ */
+int zombie_get_usage(zombie_usage_t *usage, int max);
+
+/**
+ * @brief Consulta en O(1) el estado de un hijo creado por la librería.
+ * Las salidas se conservan en un registro de tamaño fijo hasta que su ranura se
+ * necesita para un hijo nuevo.
+ * @param pid PID devuelto por zombie_safe_fork o zombie_spawn_ex.
+ * @param status Destino del estado (puede ser NULL para solo comprobar existencia).
+ * @return 0 si el hijo está en el registro, -1 con errno = ESRCH si no.
+ */
+int zombie_get_child_status(pid_t pid, zombie_child_status_t *status);
+
+/**
+ * @brief Espera a que un hijo creado por la librería termine y sea cosechado.
+ * No compite con el backend por el waitpid(): espera a que este publique el estado.
+ * @param pid PID del hijo.
+ * @param timeout_ms Tiempo máximo en milisegundos (negativo = sin límite).
+ * @param status Destino del estado final (puede ser NULL).
+ * @return 0 en éxito, -1 con errno = ETIMEDOUT o ESRCH.
+ */
+int zombie_wait_child(pid_t pid, int timeout_ms, zombie_child_status_t *status);
+
+// --- Escaneo de /proc (zombie_scan.c) ---
+
+#define ZOMBIE_COMM_LEN 64 // Longitud máxima del comm en /proc/[pid]/stat (con '\0')
+
+// Contexto de escaneo opaco: conserva el descriptor de /proc y sus buffers entre llamadas
+typedef struct zombie_scan_ctx zombie_scan_ctx_t;
+
+// Un proceso zombie encontrado por zombie_scan
+typedef struct {
+    pid_t pid;
+    pid_t ppid;
+    unsigned long long utime;      // Ticks de CPU en modo usuario (sysconf(_SC_CLK_TCK) por segundo)
+    unsigned long long stime;      // Ticks de CPU en modo kernel
+    unsigned long long start_time; // Ticks desde el arranque (distingue PIDs reutilizados)
+    char comm[ZOMBIE_COMM_LEN];
+} zombie_scan_entry_t;
+
+// Campos de /proc/[pid]/stat que interpretan zombie_scan y zombie_detector
+typedef struct {
+    pid_t pid;
+    pid_t ppid;
+    char state;                    // Campo 3: 'R', 'S', 'Z', ...
+    unsigned long long utime;      // Campo 14 (ticks)
+    unsigned long long stime;      // Campo 15 (ticks)
+    unsigned long long start_time; // Campo 22 (ticks desde el arranque)
+    char comm[ZOMBIE_COMM_LEN];
+} zombie_proc_stat_t;
+
+// Resultado de un escaneo; apunta a memoria del contexto
+typedef struct {
+    const zombie_scan_entry_t *zombies;
+    size_t count;
+    size_t processes;          // Procesos examinados en este escaneo
+} zombie_scan_result_t;
+
+/**
+ * @brief Crea un contexto de escaneo reutilizable.
+ * Abre /proc una sola vez; el directorio, el buffer de lectura y el arena de
+ * resultados se reutilizan en cada zombie_scan.
+ * @return Contexto, o NULL en error (errno indica la causa).
+ */
+zombie_scan_ctx_t *zombie_scan_create(void);
+
+/**
+ * @brief Recorre /proc y devuelve los procesos en estado 'Z'.
+ * Cada proceso se lee con un openat() + read() sobre el descriptor de /proc. Tras
+ * el primer escaneo (calentamiento), no hay reservas de memoria salvo que aparezcan
+ * más zombies que en cualquier escaneo anterior.
+ * @param ctx Contexto creado con zombie_scan_create.
+ * @param result Destino; válido hasta el siguiente zombie_scan o zombie_scan_destroy.
+ * @return 0 en éxito, -1 en error (errno indica la causa).
+ */
+int zombie_scan(zombie_scan_ctx_t *ctx, zombie_scan_result_t *result);
+
+/**
+ * @brief Analiza el contenido de un /proc/[pid]/stat ya leído.
+ * El comm puede contener espacios y paréntesis: se delimita con el ÚLTIMO ')'.
+ * @param buf Contenido del archivo (no necesita terminar en '\0').
+ * @param len Bytes válidos en `buf`.
+ * @param stat Destino.
+ * @return 0 en éxito, -1 si el contenido no es válido.
+ */
+int zombie_parse_stat(const char *buf, size_t len, zombie_proc_stat_t *stat);
+
+/**
+ * @brief Libera el contexto y cierra /proc.
+ */
+void zombie_scan_destroy(zombie_scan_ctx_t *ctx);
+
 #endif // ZOMBIE_H
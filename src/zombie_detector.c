@@ -4,45 +4,208 @@
 #include <dirent.h>
 #include <ctype.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <time.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
 
-#define MAX_ZOMBIES 1024
+#include "zombie.h"
+
+#define ZOMBIE_CHUNK_SIZE 1024 // Zombies por bloque del arena (la lista no tiene tope)
+#define MAX_SCAN_THREADS 256
+#define COMM_LEN ZOMBIE_COMM_LEN
+#define STAT_BUF_SIZE 4096 // /proc/[pid]/stat ocupa ~300 bytes; el comm admite hasta 64
+
+// Modo --watch (netlink proc connector)
+#define ANCESTRY_REPORT_MAX 20   // Padres con cadena de ancestros en el reporte
+
+#define WATCH_RECV_BUF 65536     // Buffer de recepción de eventos
+#define WATCH_SOCK_RCVBUF (4 << 20)
+#define WATCH_PENDING_MAX 4096   // Salidas a la espera de que el proceso pase a 'Z'
+#define WATCH_RETRY_MS 1         // Primer reintento para salidas aún no visibles como zombie
+#define WATCH_RETRY_MAX_MS 256   // Tope del backoff exponencial entre reintentos
+#define WATCH_RETRY_LIMIT 12     // ~1.3 s en total antes de abandonar la salida
+#define WATCH_SWEEP_MS 1000      // Revisión de zombies conocidos (detectar su cosecha)
+
+// Modo --track (serie temporal por padre, memoria acotada)
+#define TRACK_WINDOW 60           // Muestras en el anillo de cada padre (ventana = 60 * intervalo)
+#define TRACK_MAX_PARENTS 1024    // Padres seguidos a la vez
+#define TRACK_TABLE_SIZE 2048     // Potencia de dos, >= 2 * TRACK_MAX_PARENTS
+#define TRACK_AGE_BUCKETS 5       // <10s, <1m, <10m, <1h, >=1h
+#define TRACK_DEFAULT_RATE 1.0    // Zombies nuevos por segundo que disparan la alerta
+#define TRACK_LOG_FILE "/tmp/zombie_track.log"
+
+// Salida para máquinas (--format)
+#define OUT_BUF_SIZE (1 << 16)   // Un write() por cada 64 KiB de registros
+#define BINARY_MAGIC 0x504e535au // "ZSNP" en little-endian
+#define BINARY_VERSION 1
 
 // Estructura para almacenar información básica de los zombies
 typedef struct {
     int pid;
     int ppid;
-    char command[256];
+    long cputime_sec; // utime + stime, ya convertido a segundos durante el escaneo
+    char command[COMM_LEN];
 } zombie_info_t;
 
+// Bloque del arena de zombies: se encadenan sin copiar nunca los ya almacenados
+typedef struct zombie_chunk {
+    struct zombie_chunk *next;
+    int count;
+    zombie_info_t items[ZOMBIE_CHUNK_SIZE];
+} zombie_chunk_t;
+
+// Lista de zombies sin límite de capacidad, respaldada por bloques de tamaño fijo
+typedef struct {
+    zombie_chunk_t *head;
+    zombie_chunk_t *tail;
+    long total;
+} zombie_list_t;
+
+// Entrada del mapa ppid -> número de zombies (count == 0 indica hueco libre)
+typedef struct {
+    int ppid;
+    int count;
+} parent_entry_t;
+
+// Proceso visto durante el escaneo (todos, no solo los zombies)
+typedef struct {
+    int pid;
+    int ppid;
+    char state;
+    char comm[COMM_LEN];
+} proc_node_t;
+
+// Índice del árbol de procesos: arreglos planos y lista de hijos contigua (CSR)
+typedef struct {
+    proc_node_t *nodes;
+    int n;
+    int pid_max;
+    int *index_of_pid;      // pid -> índice + 1 (0 = ausente); calloc(pid_max + 1)
+    int *parent;            // Índice del padre, o -1 si es raíz
+    int *child_start;       // Hijos de i: children[child_start[i] .. child_start[i + 1])
+    int *children;
+    long *subtree_zombies;  // Zombies en todo el subárbol (sin contar al propio nodo)
+} proc_index_t;
+
+// Registro completo de /proc/[pid]/stat, analizado por zombie_parse_stat (libzombie)
+typedef zombie_proc_stat_t proc_stat_t;
+
+// Descriptor de /proc abierto una vez: cada stat se abre con openat() relativo a él
+static int proc_fd = -1;
+
 /**
- * @brief Obtiene el tiempo de CPU (user + system) en segundos de un proceso.
- * @param pid ID del proceso.
- * @return Tiempo total de CPU en segundos, o -1 en caso de error.
+ * @brief Abre /proc (una sola vez por ejecución).
+ * @return 0 en éxito, -1 en error.
  */
-long get_cputime_seconds(int pid) {
-    char stat_path[300];
-    FILE *fp;
-    long utime, stime;
-    long Hertz = sysconf(_SC_CLK_TCK);
-
-    sprintf(stat_path, "/proc/%d/stat", pid);
-    fp = fopen(stat_path, "r");
-    if (!fp) {
+static int proc_open(void) {
+    if (proc_fd != -1) return 0;
+    proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (proc_fd == -1) {
+        perror("open /proc");
         return -1;
     }
+    return 0;
+}
 
-    // El archivo /proc/[pid]/stat contiene 52 campos.
-    // utime (14to campo) y stime (15to campo) son los tiempos que nos interesan.
-    // Usamos el formato para leer hasta el campo 15.
-    if (fscanf(fp, "%*d %*s %*c %*d %*d %*d %*d %*d %*d %*d %*d %*d %*d %ld %ld", 
-               &utime, &stime) != 2) {
+static int read_pid_max(void) {
+    int pid_max = 4194304; // Límite del kernel si no se puede leer
+    FILE *fp = fopen("/proc/sys/kernel/pid_max", "r");
+    if (fp) {
+        if (fscanf(fp, "%d", &pid_max) != 1) pid_max = 4194304;
         fclose(fp);
-        return -1;
     }
+    return pid_max;
+}
+
+/**
+ * @brief Lee /proc/[pid]/stat con un solo openat() + read() a un buffer en pila y lo
+ * analiza con zombie_parse_stat.
+ * @return 0 en éxito, -1 si el proceso ya no existe o el contenido no es válido.
+ */
+static int read_proc_stat(int pid, proc_stat_t *rec) {
+    char path[32];
+    char buf[STAT_BUF_SIZE];
+
+    // "<pid>/stat" sin snprintf: el PID se escribe de derecha a izquierda
+    char digits[16];
+    int n_digits = 0;
+    unsigned int value = (unsigned int) pid;
+    do {
+        digits[n_digits++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    int len = 0;
+    while (n_digits) path[len++] = digits[--n_digits];
+    memcpy(path + len, "/stat", sizeof("/stat"));
+
+    int fd = openat(proc_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return -1;
+    ssize_t n;
+    do {
+        n = read(fd, buf, sizeof(buf));
+    } while (n == -1 && errno == EINTR);
+    close(fd);
+    if (n <= 0) return -1;
+
+    return zombie_parse_stat(buf, (size_t) n, rec);
+}
+
+/**
+ * @brief Añade un zombie al final de la lista, reservando un bloque nuevo si hace falta.
+ * @return 0 en éxito, -1 si no hay memoria.
+ */
+static int zombie_list_push(zombie_list_t *list, const zombie_info_t *info) {
+    if (!list->tail || list->tail->count == ZOMBIE_CHUNK_SIZE) {
+        zombie_chunk_t *chunk = malloc(sizeof(zombie_chunk_t));
+        if (!chunk) return -1;
+        chunk->next = NULL;
+        chunk->count = 0;
+        if (list->tail) {
+            list->tail->next = chunk;
+        } else {
+            list->head = chunk;
+        }
+        list->tail = chunk;
+    }
+    list->tail->items[list->tail->count++] = *info;
+    list->total++;
+    return 0;
+}
+
+/**
+ * @brief Mueve todos los bloques de `src` al final de `dst` en O(1).
+ */
+static void zombie_list_splice(zombie_list_t *dst, zombie_list_t *src) {
+    if (!src->head) return;
+    if (dst->tail) {
+        dst->tail->next = src->head;
+    } else {
+        dst->head = src->head;
+    }
+    dst->tail = src->tail;
+    dst->total += src->total;
+    src->head = src->tail = NULL;
+    src->total = 0;
+}
 
-    fclose(fp);
-    // El tiempo total es la suma, dividido por el valor de HZ (ticks por segundo)
-    return (utime + stime) / Hertz;
+static void zombie_list_free(zombie_list_t *list) {
+    zombie_chunk_t *chunk = list->head;
+    while (chunk) {
+        zombie_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    list->head = list->tail = NULL;
+    list->total = 0;
 }
 
 /**
@@ -61,25 +224,31 @@ void print_zombie_info(const zombie_info_t *info, long cputime_sec) {
 }
 
 /**
- * @brief Escanea el sistema de archivos /proc en busca de procesos zombie.
- * @param zombie_list Arreglo para almacenar la información de los zombies encontrados.
- * @param max_zombies Capacidad máxima del arreglo.
- * @return Número de zombies encontrados.
+ * @brief Lista los PIDs presentes en /proc (entradas que solo contienen dígitos).
+ * @param pids_out Arreglo reservado con malloc que el llamador debe liberar.
+ * @return Número de PIDs, o -1 en caso de error.
  */
-int find_zombies(zombie_info_t *zombie_list, int max_zombies) {
+static int list_pids(int **pids_out) {
     DIR *dir;
     struct dirent *entry;
-    int zombies_found = 0;
+    int count = 0, capacity = 1024;
+    int *pids = malloc(capacity * sizeof(int));
 
-    // 1. Abrir el directorio /proc
-    dir = opendir("/proc");
-    if (dir == NULL) {
+    // 1. Abrir el directorio /proc (una copia del descriptor: closedir() la cierra)
+    int dir_fd = proc_open() == 0 ? dup(proc_fd) : -1;
+    dir = dir_fd != -1 ? fdopendir(dir_fd) : NULL;
+    if (dir == NULL || pids == NULL) {
         perror("opendir /proc");
-        return 0;
+        if (dir == NULL && dir_fd != -1) close(dir_fd);
+        free(pids);
+        if (dir) closedir(dir);
+        return -1;
     }
+    // La copia comparte el offset con proc_fd: sin rewinddir(), un segundo escaneo no vería nada
+    rewinddir(dir);
 
     // 2. Iterar sobre las entradas del directorio /proc
-    while ((entry = readdir(dir)) != NULL && zombies_found < max_zombies) {
+    while ((entry = readdir(dir)) != NULL) {
         // Verificar si la entrada es un PID (solo contiene dígitos)
         int is_pid = 1;
         for (char *p = entry->d_name; *p; p++) {
@@ -88,133 +257,1262 @@ int find_zombies(zombie_info_t *zombie_list, int max_zombies) {
                 break;
             }
         }
+        if (!is_pid) continue;
 
-        if (is_pid) {
-            char stat_path[256];
-            FILE *fp;
-            int pid, ppid;
-            char comm[256];
-            char state;
-
-            // 3. Construir la ruta a /proc/[pid]/stat
-            snprintf(stat_path, sizeof(stat_path),"/proc/%s/stat", entry->d_name);
-            fp = fopen(stat_path, "r");
-
-            if (fp) {
-                // 4. Leer el archivo /proc/[pid]/stat para obtener PID, COMM, Estado y PPID
-                // Formato de lectura: %d (PID) %s (COMM) %c (STATE) %d (PPID)
-                if (fscanf(fp, "%d %s %c %d", &pid, comm, &state, &ppid) == 4) {
-                    // 5. Detectar el estado 'Z' (Zombie)
-                    if (state == 'Z') {
-                        // Limpiar el nombre del comando: quitar paréntesis
-                        comm[strlen(comm) - 1] = '\0'; // Quita el ')' final
-                        
-                        // Almacenar la información del zombie
-                        zombie_list[zombies_found].pid = pid;
-                        zombie_list[zombies_found].ppid = ppid;
-                        strcpy(zombie_list[zombies_found].command, comm + 1); // Quita el '(' inicial
-
-                        zombies_found++;
-                    }
-                }
-                fclose(fp);
-            }
+        if (count == capacity) {
+            int *grown = realloc(pids, 2 * capacity * sizeof(int));
+            if (!grown) break;
+            pids = grown;
+            capacity *= 2;
         }
+        pids[count++] = atoi(entry->d_name);
     }
 
     closedir(dir);
-    return zombies_found;
+    *pids_out = pids;
+    return count;
 }
 
 /**
- * @brief Implementa la lógica de análisis del proceso padre.
- * @param zombie_list Lista de zombies encontrados.
- * @param count Número de zombies encontrados.
+ * @brief Convierte un registro de /proc/[pid]/stat en la información del zombie.
+ * @param hertz sysconf(_SC_CLK_TCK), leído una vez antes de crear los hilos.
  */
-void analyze_parents(const zombie_info_t *zombie_list, int count) {
-    if (count == 0) return;
+static void zombie_info_from_stat(const proc_stat_t *rec, long hertz, zombie_info_t *info) {
+    info->pid = rec->pid;
+    info->ppid = rec->ppid;
+    info->cputime_sec = (long)((rec->utime + rec->stime) / (unsigned long long) hertz);
+    strcpy(info->command, rec->comm);
+}
 
-    // Encontrar PPIDs únicos y contar sus zombies
-    // En un sistema real se usaría un hash map, aquí usaremos un array simple.
-    int parent_pids[count];
-    int zombie_counts[count];
-    int unique_parents = 0;
+// Partición del escaneo asignada a un hilo, con su propia lista de resultados
+typedef struct {
+    const int *pids;
+    int start, end;
+    zombie_list_t results;
+    proc_node_t *nodes;   // Todos los procesos del rango (solo si se construye el índice)
+    int n_nodes, cap_nodes;
+    int want_nodes;
+    long hertz;           // Ticks de CPU por segundo
+} scan_task_t;
 
-    for (int i = 0; i < count; i++) {
-        int ppid = zombie_list[i].ppid;
-        int found = 0;
-        for (int j = 0; j < unique_parents; j++) {
-            if (parent_pids[j] == ppid) {
-                zombie_counts[j]++;
-                found = 1;
-                break;
+/**
+ * @brief Hilo de escaneo: recorre su rango de PIDs sin compartir estado con otros hilos.
+ */
+static void *scan_worker(void *arg) {
+    scan_task_t *task = arg;
+    zombie_info_t info;
+    proc_stat_t rec;
+
+    for (int i = task->start; i < task->end; i++) {
+        // Un solo read() del stat: PID, COMM, estado, PPID y tiempos de CPU
+        if (read_proc_stat(task->pids[i], &rec) != 0) continue;
+
+        if (task->want_nodes) {
+            if (task->n_nodes == task->cap_nodes) {
+                int capacity = task->cap_nodes ? 2 * task->cap_nodes : 256;
+                proc_node_t *grown = realloc(task->nodes, capacity * sizeof(proc_node_t));
+                if (!grown) {
+                    perror("malloc proc_index");
+                    break;
+                }
+                task->nodes = grown;
+                task->cap_nodes = capacity;
             }
+            proc_node_t *node = &task->nodes[task->n_nodes++];
+            node->pid = rec.pid;
+            node->ppid = rec.ppid;
+            node->state = rec.state;
+            strcpy(node->comm, rec.comm);
+        }
+
+        if (rec.state != 'Z') continue;
+        zombie_info_from_stat(&rec, task->hertz, &info);
+        if (zombie_list_push(&task->results, &info) == -1) {
+            perror("malloc zombie_list");
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Escanea el sistema de archivos /proc en busca de procesos zombie.
+ * Con más de un hilo, la lista de PIDs se reparte en rangos contiguos; cada hilo
+ * acumula en su propia lista y al final se encadenan en el orden de /proc.
+ * @param zombie_list Lista (vacía) donde se almacenan los zombies encontrados.
+ * @param num_threads Número de hilos de escaneo (1 = secuencial).
+ * @param index Si no es NULL, recibe todos los procesos vistos (ver proc_index_build).
+ * @return Número de zombies encontrados.
+ */
+long find_zombies(zombie_list_t *zombie_list, int num_threads, proc_index_t *index) {
+    int *pids;
+    int total = list_pids(&pids);
+    if (total <= 0) return 0;
+
+    if (num_threads > total) num_threads = total;
+    if (num_threads < 1) num_threads = 1;
+
+    scan_task_t tasks[num_threads];
+    pthread_t threads[num_threads];
+    int chunk = (total + num_threads - 1) / num_threads;
+    long hertz = sysconf(_SC_CLK_TCK);
+
+    for (int t = 0; t < num_threads; t++) {
+        tasks[t] = (scan_task_t){pids, t * chunk, (t + 1) * chunk, {NULL, NULL, 0}, NULL, 0, 0, index != NULL, hertz};
+        if (tasks[t].start > total) tasks[t].start = total;
+        if (tasks[t].end > total) tasks[t].end = total;
+    }
+
+    // El hilo principal escanea la primera partición en lugar de quedarse esperando
+    for (int t = 1; t < num_threads; t++) {
+        if (pthread_create(&threads[t], NULL, scan_worker, &tasks[t]) != 0) {
+            threads[t] = 0;
+            scan_worker(&tasks[t]);
+        }
+    }
+    scan_worker(&tasks[0]);
+
+    // Fusionar las listas de cada hilo: se encadenan los bloques, sin copiar zombies
+    int total_nodes = 0;
+    for (int t = 0; t < num_threads; t++) {
+        if (t > 0 && threads[t]) pthread_join(threads[t], NULL);
+        zombie_list_splice(zombie_list, &tasks[t].results);
+        total_nodes += tasks[t].n_nodes;
+    }
+
+    // Los procesos de cada hilo se concatenan en un único arreglo para el índice
+    if (index) {
+        index->nodes = malloc((total_nodes ? total_nodes : 1) * sizeof(proc_node_t));
+        index->n = 0;
+        for (int t = 0; t < num_threads; t++) {
+            if (index->nodes && tasks[t].n_nodes > 0) {
+                memcpy(index->nodes + index->n, tasks[t].nodes, tasks[t].n_nodes * sizeof(proc_node_t));
+                index->n += tasks[t].n_nodes;
+            }
+            free(tasks[t].nodes);
+        }
+    }
+
+    free(pids);
+    return zombie_list->total;
+}
+
+/**
+ * @brief Construye el árbol a partir de los procesos del escaneo, en O(n).
+ * Enlaza cada nodo con su padre, agrupa los hijos en un arreglo contiguo (CSR)
+ * y acumula los zombies de cada subárbol recorriendo el orden BFS al revés.
+ * No realiza lecturas adicionales de /proc.
+ * @return 0 en éxito, -1 si no hay memoria.
+ */
+static int proc_index_build(proc_index_t *index) {
+    int n = index->n;
+    index->pid_max = read_pid_max();
+    index->index_of_pid = calloc((size_t) index->pid_max + 1, sizeof(int));
+    index->parent = malloc((n + 1) * sizeof(int));
+    index->child_start = calloc((size_t) n + 2, sizeof(int));
+    index->children = malloc((n + 1) * sizeof(int));
+    index->subtree_zombies = calloc((size_t) n + 1, sizeof(long));
+    int *order = malloc((n + 1) * sizeof(int));
+    if (!index->nodes || !index->index_of_pid || !index->parent || !index->child_start ||
+        !index->children || !index->subtree_zombies || !order) {
+        free(order);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (index->nodes[i].pid <= index->pid_max) index->index_of_pid[index->nodes[i].pid] = i + 1;
+    }
+
+    // 1. Padre de cada nodo y número de hijos (conteo para el CSR)
+    for (int i = 0; i < n; i++) {
+        int ppid = index->nodes[i].ppid;
+        int p = (ppid > 0 && ppid <= index->pid_max) ? index->index_of_pid[ppid] - 1 : -1;
+        index->parent[i] = p == i ? -1 : p;
+        if (index->parent[i] >= 0) index->child_start[index->parent[i] + 1]++;
+    }
+
+    // 2. Prefijos: child_start[i] es el inicio de los hijos de i
+    for (int i = 0; i < n; i++) index->child_start[i + 1] += index->child_start[i];
+    int *fill = order; // Reutiliza el buffer como cursor de inserción
+    for (int i = 0; i < n; i++) fill[i] = index->child_start[i];
+    for (int i = 0; i < n; i++) {
+        if (index->parent[i] >= 0) index->children[fill[index->parent[i]]++] = i;
+    }
+
+    // 3. Orden BFS desde las raíces; al recorrerlo al revés cada hijo precede a su padre
+    int head = 0, tail = 0;
+    for (int i = 0; i < n; i++) {
+        if (index->parent[i] < 0) order[tail++] = i;
+    }
+    while (head < tail) {
+        int v = order[head++];
+        for (int c = index->child_start[v]; c < index->child_start[v + 1]; c++) {
+            order[tail++] = index->children[c];
+        }
+    }
+    for (int k = tail - 1; k >= 0; k--) {
+        int v = order[k];
+        int p = index->parent[v];
+        if (p >= 0) {
+            index->subtree_zombies[p] += index->subtree_zombies[v] + (index->nodes[v].state == 'Z');
         }
-        if (!found) {
-            parent_pids[unique_parents] = ppid;
-            zombie_counts[unique_parents] = 1;
-            unique_parents++;
+    }
+
+    free(order);
+    return 0;
+}
+
+static void proc_index_free(proc_index_t *index) {
+    free(index->nodes);
+    free(index->index_of_pid);
+    free(index->parent);
+    free(index->child_start);
+    free(index->children);
+    free(index->subtree_zombies);
+    memset(index, 0, sizeof(*index));
+}
+
+/**
+ * @brief Busca un PID en el índice.
+ * @return Índice del nodo, o -1 si no estaba en el escaneo.
+ */
+static int proc_index_find(const proc_index_t *index, int pid) {
+    if (!index || !index->index_of_pid || pid <= 0 || pid > index->pid_max) return -1;
+    return index->index_of_pid[pid] - 1;
+}
+
+/**
+ * @brief Imprime la cadena de ancestros de un padre con zombies, desde la raíz,
+ * con los zombies acumulados en el subárbol de cada eslabón.
+ */
+static void print_ancestry(const proc_index_t *index, int node) {
+    int chain[64];
+    int depth = 0;
+
+    // La profundidad se acota: un ciclo (datos de procesos que cambiaron durante el
+    // escaneo) no puede colgar el reporte
+    for (int v = node; v >= 0 && depth < 64; v = index->parent[v]) {
+        chain[depth++] = v;
+    }
+
+    printf("    ");
+    for (int k = depth - 1; k >= 0; k--) {
+        const proc_node_t *p = &index->nodes[chain[k]];
+        printf("%s(%d)[%ld]%s", p->comm, p->pid, index->subtree_zombies[chain[k]], k > 0 ? " -> " : "\n");
+    }
+}
+
+static unsigned int ppid_hash(int ppid) {
+    return (unsigned int) ppid * 2654435761u;
+}
+
+/**
+ * @brief Cuenta los zombies de cada PPID con una tabla hash de direccionamiento abierto.
+ * La tabla se dimensiona a una potencia de dos >= 2x el número de zombies, así que
+ * nunca se llena y cada inserción es O(1) esperado.
+ * @param unique_out Número de padres distintos encontrados.
+ * @return Tabla compactada (solo entradas usadas), reservada con malloc.
+ */
+static parent_entry_t *count_parents(const zombie_list_t *zombie_list, int *unique_out) {
+    size_t size = 16;
+    while (size < 2 * (size_t) zombie_list->total) size <<= 1;
+
+    parent_entry_t *table = calloc(size, sizeof(parent_entry_t));
+    if (!table) return NULL;
+
+    int unique = 0;
+    for (const zombie_chunk_t *chunk = zombie_list->head; chunk; chunk = chunk->next) {
+        for (int i = 0; i < chunk->count; i++) {
+            int ppid = chunk->items[i].ppid;
+            size_t slot = ppid_hash(ppid) & (size - 1);
+            while (table[slot].count != 0 && table[slot].ppid != ppid) {
+                slot = (slot + 1) & (size - 1);
+            }
+            if (table[slot].count == 0) {
+                table[slot].ppid = ppid;
+                unique++;
+            }
+            table[slot].count++;
         }
     }
 
+    // Compactar las entradas usadas al inicio de la tabla
+    int used = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (table[i].count != 0) table[used++] = table[i];
+    }
+    *unique_out = unique;
+    return table;
+}
+
+/**
+ * @brief Orden de los padres: más zombies primero; a igualdad, PID ascendente.
+ */
+static int compare_parents(const void *a, const void *b) {
+    const parent_entry_t *pa = a;
+    const parent_entry_t *pb = b;
+    if (pa->count != pb->count) return pa->count < pb->count ? 1 : -1;
+    return (pa->ppid > pb->ppid) - (pa->ppid < pb->ppid);
+}
+
+/**
+ * @brief Implementa la lógica de análisis del proceso padre.
+ * Tiempo lineal en el número de zombies (más el orden de los padres distintos).
+ * @param zombie_list Lista de zombies encontrados.
+ * @param index Árbol de procesos del mismo escaneo, o NULL (se lee /proc por padre).
+ */
+void analyze_parents(const zombie_list_t *zombie_list, const proc_index_t *index) {
+    if (zombie_list->total == 0) return;
+
+    int unique_parents = 0;
+    parent_entry_t *parents = count_parents(zombie_list, &unique_parents);
+    if (!parents) {
+        perror("calloc parent map");
+        return;
+    }
+
+    // El peor infractor aparece primero
+    qsort(parents, unique_parents, sizeof(parent_entry_t), compare_parents);
+
     printf("\nParent Process Analysis:\n");
     for (int i = 0; i < unique_parents; i++) {
-        char parent_cmd[256] = "unknown";
-        char stat_path[256];
-        FILE *fp;
-        int pid, ppid_dummy;
-        char state;
-        
-        // Intentar obtener el nombre del comando del padre
-        sprintf(stat_path, "/proc/%d/stat", parent_pids[i]);
-        fp = fopen(stat_path, "r");
-        if (fp) {
-            // Leer los primeros 4 campos: PID, COMM, STATE, PPID
-            if (fscanf(fp, "%d %s %c %d", &pid, parent_cmd, &state, &ppid_dummy) == 4) {
-                // Limpiar el nombre del comando
-                parent_cmd[strlen(parent_cmd) - 1] = '\0';
-                // Si el padre también es zombie o no existe, su nombre aparecerá como "defunct"
-                printf("  PID %d (%s) has %d zombie children\n", 
-                       parent_pids[i], parent_cmd + 1, zombie_counts[i]);
-            } else {
-                 printf("  PID %d (command unknown) has %d zombie children\n", 
-                       parent_pids[i], zombie_counts[i]);
-            }
-            fclose(fp);
+        proc_stat_t parent;
+        int node = proc_index_find(index, parents[i].ppid);
+
+        // El nombre del padre sale del índice; sin índice se lee su stat
+        if (node >= 0) {
+            printf("  PID %d (%s) has %d zombie children\n",
+                   parents[i].ppid, index->nodes[node].comm, parents[i].count);
+        } else if (!index && read_proc_stat(parents[i].ppid, &parent) == 0) {
+            // Si el padre también es zombie o no existe, su nombre aparecerá como "defunct"
+            printf("  PID %d (%s) has %d zombie children\n",
+                   parents[i].ppid, parent.comm, parents[i].count);
         } else {
             // Si /proc/[ppid] no existe, el padre ya terminó y fue adoptado por init (pero este reporte lo ignora)
-            printf("  PID %d (process terminated) has %d zombie children\n", 
-                   parent_pids[i], zombie_counts[i]);
+            printf("  PID %d (process terminated) has %d zombie children\n",
+                   parents[i].ppid, parents[i].count);
         }
     }
-}
-
-int main() {
-    zombie_info_t zombie_list[MAX_ZOMBIES];
-    int total_zombies;
 
-    // 1. Escanear y encontrar zombies
-    total_zombies = find_zombies(zombie_list, MAX_ZOMBIES);
+    // Cadena completa de ancestros de los peores infractores: [n] = zombies del subárbol
+    if (index && index->subtree_zombies) {
+        printf("\nZombie Ancestry (root -> parent, [zombies in subtree]):\n");
+        for (int i = 0; i < unique_parents && i < ANCESTRY_REPORT_MAX; i++) {
+            int node = proc_index_find(index, parents[i].ppid);
+            if (node >= 0) print_ancestry(index, node);
+        }
+    }
+    free(parents);
+}
 
+/**
+ * @brief Imprime el reporte completo (tabla de zombies y análisis de padres).
+ * @param index Árbol de procesos del mismo escaneo, o NULL.
+ */
+static void print_report(const zombie_list_t *zombie_list, const proc_index_t *index) {
     // 2. Imprimir el encabezado del reporte
     printf("=== Zombie Process Report ===\n");
-    printf("Total Zombies: %d\n\n", total_zombies);
+    printf("Total Zombies: %ld\n\n", zombie_list->total);
 
-    if (total_zombies > 0) {
+    if (zombie_list->total > 0) {
         // 3. Imprimir la tabla de detalles
         printf("%-8s%-8s%-16s%-8s%-8s\n", "PID", "PPID", "Command", "State", "Time");
         printf("------- ------- ---------------- ----- --------\n");
 
-        for (int i = 0; i < total_zombies; i++) {
-            long cputime = get_cputime_seconds(zombie_list[i].pid);
-            print_zombie_info(&zombie_list[i], cputime);
+        for (const zombie_chunk_t *chunk = zombie_list->head; chunk; chunk = chunk->next) {
+            for (int i = 0; i < chunk->count; i++) {
+                print_zombie_info(&chunk->items[i], chunk->items[i].cputime_sec);
+            }
         }
 
         // 4. Imprimir el análisis de padres
-        analyze_parents(zombie_list, total_zombies);
+        analyze_parents(zombie_list, index);
     } else {
         printf("¡No se encontraron procesos zombie en el sistema!\n");
     }
+}
+
+// --- Modo --watch: eventos del netlink proc connector ---
+
+// Entrada de la tabla de procesos, indexada directamente por PID (hasta pid_max).
+// El PPID y el comando se leen de /proc al confirmar el zombie: la tabla solo
+// evita reportar dos veces el mismo zombie.
+typedef struct {
+    unsigned char zombie;
+} watch_entry_t;
+
+// Salida recibida cuyo proceso todavía no aparece como 'Z' en /proc
+typedef struct {
+    int pid;
+    int retries;
+    long long due_ms;   // Próximo reintento (backoff exponencial)
+} watch_pending_t;
+
+typedef struct {
+    watch_entry_t *table;   // calloc(pid_max): solo se tocan las páginas de PIDs usados
+    int pid_max;
+    int *zombies;           // PIDs actualmente zombie (para detectar su cosecha)
+    int n_zombies, cap_zombies;
+    watch_pending_t pending[WATCH_PENDING_MAX];
+    int n_pending;
+} watch_state_t;
+
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Se suscribe a los eventos de procesos del kernel (requiere CAP_NET_ADMIN).
+ * @return Socket netlink, o -1 en error.
+ */
+static int watch_subscribe(void) {
+    int sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (sock == -1) {
+        perror("socket NETLINK_CONNECTOR");
+        return -1;
+    }
+
+    int rcvbuf = WATCH_SOCK_RCVBUF;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_nl addr = {0};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    addr.nl_pid = getpid();
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+        perror("bind NETLINK_CONNECTOR");
+        close(sock);
+        return -1;
+    }
+
+    struct {
+        struct nlmsghdr nl;
+        struct cn_msg cn;
+        enum proc_cn_mcast_op op;
+    } __attribute__((packed)) req;
+    memset(&req, 0, sizeof(req));
+    req.nl.nlmsg_len = sizeof(req);
+    req.nl.nlmsg_type = NLMSG_DONE;
+    req.nl.nlmsg_pid = getpid();
+    req.cn.id.idx = CN_IDX_PROC;
+    req.cn.id.val = CN_VAL_PROC;
+    req.cn.len = sizeof(enum proc_cn_mcast_op);
+    req.op = PROC_CN_MCAST_LISTEN;
+
+    if (send(sock, &req, sizeof(req), 0) == -1) {
+        perror("send PROC_CN_MCAST_LISTEN (¿CAP_NET_ADMIN?)");
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static void watch_add_zombie(watch_state_t *w, int pid) {
+    if (w->n_zombies == w->cap_zombies) {
+        int cap = w->cap_zombies ? 2 * w->cap_zombies : 256;
+        int *grown = realloc(w->zombies, cap * sizeof(int));
+        if (!grown) return;
+        w->zombies = grown;
+        w->cap_zombies = cap;
+    }
+    w->zombies[w->n_zombies++] = pid;
+    w->table[pid].zombie = 1;
+}
+
+/**
+ * @brief Foto inicial: llena la tabla de procesos y la lista de zombies en una pasada.
+ */
+static void watch_snapshot(watch_state_t *w, zombie_list_t *zombie_list) {
+    int *pids;
+    int total = list_pids(&pids);
+    long hertz = sysconf(_SC_CLK_TCK);
+
+    memset(w->table, 0, (size_t)(w->pid_max + 1) * sizeof(watch_entry_t));
+    w->n_zombies = 0;
+
+    for (int i = 0; i < total; i++) {
+        proc_stat_t rec;
+        if (pids[i] > w->pid_max || read_proc_stat(pids[i], &rec) != 0) continue;
+        if (rec.state == 'Z') {
+            watch_add_zombie(w, rec.pid);
+            if (zombie_list) {
+                zombie_info_t info = {rec.pid, rec.ppid, (long)((rec.utime + rec.stime) / hertz), ""};
+                strcpy(info.command, rec.comm);
+                zombie_list_push(zombie_list, &info);
+            }
+        }
+    }
+    if (total > 0) free(pids);
+}
+
+/**
+ * @brief Revisa un proceso que acaba de terminar.
+ * @return 1 si debe reintentarse (aún no es visible como zombie), 0 si ya se resolvió.
+ */
+static int watch_check_exit(watch_state_t *w, int pid) {
+    proc_stat_t rec;
+    if (read_proc_stat(pid, &rec) != 0) {
+        // Ya no existe: el padre lo cosechó antes de que lo viéramos
+        return 0;
+    }
+    if (rec.state != 'Z') {
+        // El evento EXIT llega antes de que el kernel marque la tarea como zombie
+        return rec.state != 'X';
+    }
+    if (w->table[pid].zombie) return 0;
+
+    proc_stat_t parent;
+    const char *parent_comm = read_proc_stat(rec.ppid, &parent) == 0 ? parent.comm : "unknown";
+    watch_add_zombie(w, pid);
+    printf("+zombie PID %d (%s) PPID %d (%s)\n", pid, rec.comm, rec.ppid, parent_comm);
+    return 0;
+}
+
+/**
+ * @brief Retira de la lista a los zombies que ya fueron cosechados.
+ */
+static void watch_sweep(watch_state_t *w) {
+    for (int i = 0; i < w->n_zombies; ) {
+        int pid = w->zombies[i];
+        proc_stat_t rec;
+        if (read_proc_stat(pid, &rec) == 0 && rec.state == 'Z') {
+            i++;
+            continue;
+        }
+        printf("-zombie PID %d reaped\n", pid);
+        w->table[pid].zombie = 0;
+        w->zombies[i] = w->zombies[--w->n_zombies];
+    }
+}
+
+/**
+ * @brief Programa el siguiente reintento de una salida pendiente.
+ * @return 1 si queda programado, 0 si se agotaron los reintentos.
+ */
+static int watch_backoff(watch_pending_t *p, long long now) {
+    if (p->retries >= WATCH_RETRY_LIMIT) return 0;
+    int shift = p->retries++;
+    long long delay = shift < 8 ? (long long) WATCH_RETRY_MS << shift : WATCH_RETRY_MAX_MS;
+    p->due_ms = now + (delay < WATCH_RETRY_MAX_MS ? delay : WATCH_RETRY_MAX_MS);
+    return 1;
+}
+
+/**
+ * @brief Aplica un evento del proc connector a la tabla de procesos.
+ */
+static void watch_handle_event(watch_state_t *w, const struct proc_event *ev, long long now) {
+    if (ev->what == PROC_EVENT_FORK) {
+        // Solo procesos (líderes de grupo), no hilos. Un PID reutilizado deja de ser zombie.
+        int child = ev->event_data.fork.child_pid;
+        if (child == ev->event_data.fork.child_tgid && child <= w->pid_max) {
+            w->table[child].zombie = 0;
+        }
+    } else if (ev->what == PROC_EVENT_EXIT) {
+        int pid = ev->event_data.exit.process_pid;
+        if (pid != ev->event_data.exit.process_tgid || pid > w->pid_max) return;
+        // Solo se relee /proc para el PID que acaba de terminar
+        if (watch_check_exit(w, pid) && w->n_pending < WATCH_PENDING_MAX) {
+            watch_pending_t *p = &w->pending[w->n_pending++];
+            *p = (watch_pending_t){pid, 0, 0};
+            watch_backoff(p, now);
+        }
+    }
+}
+
+/**
+ * @brief Milisegundos hasta el próximo reintento pendiente o la próxima revisión.
+ */
+static int watch_timeout(const watch_state_t *w, long long next_sweep_ms, long long now) {
+    long long due = next_sweep_ms;
+    for (int i = 0; i < w->n_pending; i++) {
+        if (w->pending[i].due_ms < due) due = w->pending[i].due_ms;
+    }
+    return due > now ? (int)(due - now) : 0;
+}
+
+/**
+ * @brief Modo --watch: reporte inicial y luego eventos incrementales hasta una señal.
+ * @return Código de salida del programa.
+ */
+static int run_watch(void) {
+    static watch_state_t w;
+    zombie_list_t initial = {NULL, NULL, 0};
+
+    // Suscribirse antes de la foto inicial: ningún evento cae entre ambas
+    int sock = watch_subscribe();
+    if (sock == -1 || proc_open() == -1) return 1;
+
+    w.pid_max = read_pid_max();
+    w.table = calloc((size_t) w.pid_max + 1, sizeof(watch_entry_t));
+    if (!w.table) {
+        perror("calloc process table");
+        return 1;
+    }
+
+    watch_snapshot(&w, &initial);
+    print_report(&initial, NULL);
+    zombie_list_free(&initial);
+    printf("\n=== Watching (netlink proc connector) ===\n");
+    fflush(stdout);
+
+    static char buf[WATCH_RECV_BUF] __attribute__((aligned(NLMSG_ALIGNTO)));
+    long long next_sweep_ms = monotonic_ms() + WATCH_SWEEP_MS;
+    for (;;) {
+        struct pollfd pfd = {sock, POLLIN, 0};
+        int ready = poll(&pfd, 1, watch_timeout(&w, next_sweep_ms, monotonic_ms()));
+        if (ready == -1 && errno != EINTR) {
+            perror("poll");
+            return 1;
+        }
+        long long now = monotonic_ms();
+
+        if (ready > 0) {
+            ssize_t len = recv(sock, buf, sizeof(buf), MSG_DONTWAIT);
+            if (len == -1 && errno == ENOBUFS) {
+                // Se perdieron eventos: la tabla ya no es fiable, se reconstruye
+                printf("[watch] eventos perdidos (ENOBUFS): re-escaneando /proc\n");
+                int known = w.n_zombies;
+                watch_snapshot(&w, NULL);
+                printf("[watch] %d zombies conocidos, %d tras el re-escaneo\n", known, w.n_zombies);
+                w.n_pending = 0;
+            }
+            for (struct nlmsghdr *nl = (struct nlmsghdr *) buf; len > 0 && NLMSG_OK(nl, (size_t) len);
+                 nl = NLMSG_NEXT(nl, len)) {
+                if (nl->nlmsg_type != NLMSG_DONE) continue;
+                struct cn_msg *cn = NLMSG_DATA(nl);
+                if (cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC) continue;
+                watch_handle_event(&w, (const struct proc_event *) cn->data, now);
+            }
+        }
+
+        // Reintentar (solo las vencidas) las salidas que aún no eran visibles como zombie
+        int kept = 0;
+        for (int i = 0; i < w.n_pending; i++) {
+            watch_pending_t *p = &w.pending[i];
+            if (p->due_ms > now || (watch_check_exit(&w, p->pid) && watch_backoff(p, now))) {
+                w.pending[kept++] = *p;
+            }
+        }
+        w.n_pending = kept;
+
+        // La cosecha no genera eventos: los zombies conocidos se revisan con su propio
+        // plazo, haya o no salidas pendientes
+        if (now >= next_sweep_ms) {
+            watch_sweep(&w);
+            next_sweep_ms = now + WATCH_SWEEP_MS;
+        }
+        fflush(stdout);
+    }
+}
+
+// --- Modo --track: serie temporal de zombies por padre ---
+
+// Padre seguido. La clave es (ppid, start_time): un PID reutilizado es otro padre.
+typedef struct {
+    int ppid;                            // 0 = hueco libre
+    unsigned long long start_time;       // starttime del padre (ticks desde el arranque)
+    char comm[COMM_LEN];
+    uint32_t zombies[TRACK_WINDOW];      // Zombies presentes en cada muestra del anillo
+    uint32_t born[TRACK_WINDOW];         // Zombies nuevos en cada muestra del anillo
+    uint64_t born_in_window;             // Suma móvil de born[] (se actualiza al rotar)
+    uint64_t born_total;
+    long long last_seen;                 // Última muestra en la que tuvo zombies
+    uint32_t ages[TRACK_AGE_BUCKETS];    // Edades de sus zombies en la muestra actual
+    int alerting;
+} track_parent_t;
+
+// Primer avistamiento de cada zombie, indexado por PID (starttime evita confundir PIDs reutilizados)
+typedef struct {
+    unsigned long long start_time;
+    long long first_seen_ms;
+} track_seen_t;
+
+typedef struct {
+    track_parent_t slots[TRACK_TABLE_SIZE]; // Tabla hash de tamaño fijo: la memoria no crece
+    int n_parents;
+    unsigned long long untracked;           // Zombies cuyo padre no cupo en la tabla
+    long long sample;                       // Número de la muestra en curso
+    long long sample_ms[TRACK_WINDOW];      // Instante de cada muestra del anillo
+    track_seen_t *seen;                     // calloc(pid_max + 1)
+    int pid_max;
+    double alert_rate;
+} track_state_t;
+
+static const char *const track_age_labels[TRACK_AGE_BUCKETS] = {"<10s", "<1m", "<10m", "<1h", ">=1h"};
+
+static int track_age_bucket(long long age_ms) {
+    if (age_ms < 10000) return 0;
+    if (age_ms < 60000) return 1;
+    if (age_ms < 600000) return 2;
+    if (age_ms < 3600000) return 3;
+    return 4;
+}
+
+/**
+ * @brief Busca (o inserta) al padre (ppid, start_time) con sondeo lineal.
+ * @return Entrada, o NULL si la tabla ya sigue a TRACK_MAX_PARENTS padres.
+ */
+static track_parent_t *track_lookup(track_state_t *t, int ppid, unsigned long long start_time, const char *comm) {
+    unsigned int mask = TRACK_TABLE_SIZE - 1;
+    unsigned int slot = (ppid_hash(ppid) ^ (unsigned int) start_time) & mask;
+
+    while (t->slots[slot].ppid != 0) {
+        track_parent_t *p = &t->slots[slot];
+        if (p->ppid == ppid && p->start_time == start_time) return p;
+        slot = (slot + 1) & mask;
+    }
+    if (t->n_parents >= TRACK_MAX_PARENTS) return NULL;
+
+    track_parent_t *p = &t->slots[slot];
+    memset(p, 0, sizeof(*p));
+    p->ppid = ppid;
+    p->start_time = start_time;
+    strcpy(p->comm, comm);
+    t->n_parents++;
+    return p;
+}
+
+/**
+ * @brief Borra la entrada `slot` desplazando hacia atrás a las que la seguían
+ * (borrado sin lápidas: las búsquedas siguen terminando en el primer hueco).
+ */
+static void track_remove(track_state_t *t, unsigned int slot) {
+    unsigned int mask = TRACK_TABLE_SIZE - 1;
+    unsigned int hole = slot;
+
+    for (unsigned int next = (hole + 1) & mask; t->slots[next].ppid != 0; next = (next + 1) & mask) {
+        const track_parent_t *p = &t->slots[next];
+        unsigned int home = (ppid_hash(p->ppid) ^ (unsigned int) p->start_time) & mask;
+        // Solo se mueve si su posición ideal no queda entre el hueco y su posición actual
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            t->slots[hole] = *p;
+            hole = next;
+        }
+    }
+    t->slots[hole].ppid = 0;
+    t->n_parents--;
+}
+
+/**
+ * @brief Zombies nuevos por segundo en la ventana del anillo.
+ * Los nacimientos de la muestra más antigua ocurrieron antes de su instante, así que no cuentan.
+ */
+static double track_rate(const track_state_t *t, const track_parent_t *p) {
+    long long n = t->sample + 1 < TRACK_WINDOW ? t->sample + 1 : TRACK_WINDOW;
+    if (n < 2) return 0.0;
+    int newest = (int)(t->sample % TRACK_WINDOW);
+    int oldest = (int)((t->sample - n + 1) % TRACK_WINDOW);
+    long long span_ms = t->sample_ms[newest] - t->sample_ms[oldest];
+    if (span_ms <= 0) return 0.0;
+    return (double)(p->born_in_window - p->born[oldest]) * 1000.0 / (double) span_ms;
+}
+
+/**
+ * @brief Toma una muestra: rota el anillo de cada padre y escanea /proc una vez.
+ * Todo el estado se actualiza en O(zombies + padres seguidos), sin recorrer el historial.
+ */
+static void track_sample(track_state_t *t) {
+    int slot = (int)(t->sample % TRACK_WINDOW);
+    long long now = monotonic_ms();
+    t->sample_ms[slot] = now;
+
+    // 1. La muestra que sale de la ventana se descuenta de las sumas móviles
+    for (int i = 0; i < TRACK_TABLE_SIZE; i++) {
+        track_parent_t *p = &t->slots[i];
+        if (p->ppid == 0) continue;
+        p->born_in_window -= p->born[slot];
+        p->born[slot] = 0;
+        p->zombies[slot] = 0;
+        memset(p->ages, 0, sizeof(p->ages));
+    }
+
+    // 2. Escanear /proc: los hermanos suelen ser contiguos, basta con recordar el último padre
+    int *pids;
+    int total = list_pids(&pids);
+    int cached_ppid = -1;
+    track_parent_t *parent = NULL;
+
+    for (int i = 0; i < total; i++) {
+        proc_stat_t rec;
+        if (pids[i] > t->pid_max || read_proc_stat(pids[i], &rec) != 0 || rec.state != 'Z') continue;
+
+        if (rec.ppid != cached_ppid) {
+            proc_stat_t pstat;
+            cached_ppid = rec.ppid;
+            parent = read_proc_stat(rec.ppid, &pstat) == 0 ? track_lookup(t, rec.ppid, pstat.start_time, pstat.comm)
+                                                           : NULL;
+        }
+        if (!parent) {
+            t->untracked++;
+            continue;
+        }
+
+        track_seen_t *seen = &t->seen[rec.pid];
+        if (seen->start_time != rec.start_time) {
+            seen->start_time = rec.start_time;
+            seen->first_seen_ms = now;
+            // Los zombies de la primera muestra ya existían: son la línea base, no una fuga
+            if (t->sample > 0) {
+                parent->born[slot]++;
+                parent->born_in_window++;
+                parent->born_total++;
+            }
+        }
+        parent->zombies[slot]++;
+        parent->ages[track_age_bucket(now - seen->first_seen_ms)]++;
+        parent->last_seen = t->sample;
+    }
+    if (total > 0) free(pids);
+
+    // 3. Alertas con histéresis: se recupera al bajar de la mitad del umbral
+    for (int i = 0; i < TRACK_TABLE_SIZE; i++) {
+        track_parent_t *p = &t->slots[i];
+        if (p->ppid == 0) continue;
+        double rate = track_rate(t, p);
+        if (!p->alerting && rate >= t->alert_rate) {
+            p->alerting = 1;
+            printf("ALERT: PPID %d (%s) leaking %.2f zombies/s (threshold %.2f), %u zombies now\n",
+                   p->ppid, p->comm, rate, t->alert_rate, p->zombies[slot]);
+        } else if (p->alerting && rate < t->alert_rate / 2) {
+            p->alerting = 0;
+            printf("RECOVERED: PPID %d (%s) %.2f zombies/s, %u zombies now\n",
+                   p->ppid, p->comm, rate, p->zombies[slot]);
+        }
+    }
+
+    // 4. Se olvida a los padres sin zombies en toda la ventana (la memoria queda acotada)
+    for (int i = 0; i < TRACK_TABLE_SIZE; ) {
+        track_parent_t *p = &t->slots[i];
+        if (p->ppid != 0 && !p->alerting && t->sample - p->last_seen >= TRACK_WINDOW) {
+            track_remove(t, (unsigned int) i); // Puede traer otra entrada a i: se revisa de nuevo
+        } else {
+            i++;
+        }
+    }
+}
+
+/**
+ * @brief Resumen de la ventana: zombies actuales, tasa de fuga y distribución de edades.
+ */
+static void track_print_summary(const track_state_t *t, double interval) {
+    int slot = (int)(t->sample % TRACK_WINDOW);
+    printf("=== Zombie Trend (sample %lld, window %.0fs, %d parents tracked) ===\n",
+           t->sample + 1, interval * TRACK_WINDOW, t->n_parents);
+    for (int i = 0; i < TRACK_TABLE_SIZE; i++) {
+        const track_parent_t *p = &t->slots[i];
+        if (p->ppid == 0 || p->zombies[slot] == 0) continue;
+        printf("PPID %d (%s): %u zombies, %.2f zombies/s, %llu new total, ages",
+               p->ppid, p->comm, p->zombies[slot], track_rate(t, p), (unsigned long long) p->born_total);
+        for (int b = 0; b < TRACK_AGE_BUCKETS; b++) printf(" %s:%u", track_age_labels[b], p->ages[b]);
+        printf("%s\n", p->alerting ? " [ALERT]" : "");
+    }
+    if (t->untracked > 0) {
+        printf("(%llu zombie samples without a tracked parent: table full or parent gone)\n", t->untracked);
+    }
+}
+
+/**
+ * @brief Modo --track: una muestra por intervalo, alertas inmediatas y un resumen por ventana.
+ * @param count Número de muestras (0 = sin fin).
+ * @return Código de salida del programa.
+ */
+static int run_track(double interval, long count, double alert_rate) {
+    static track_state_t t;
+
+    if (proc_open() == -1) return 1;
+    t.pid_max = read_pid_max();
+    t.alert_rate = alert_rate;
+    t.seen = calloc((size_t) t.pid_max + 1, sizeof(track_seen_t));
+    if (!t.seen) {
+        perror("calloc seen table");
+        return 1;
+    }
+
+    printf("=== Tracking zombies every %.2fs (alert >= %.2f zombies/s) ===\n", interval, alert_rate);
+    fflush(stdout);
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (t.sample = 0; ; t.sample++) {
+        track_sample(&t);
+        int last = count > 0 && t.sample + 1 >= count;
+        if (last || t.sample % TRACK_WINDOW == TRACK_WINDOW - 1) track_print_summary(&t, interval);
+        fflush(stdout);
+        if (last) break;
+
+        long long step_ns = (long long)(interval * 1e9);
+        next.tv_sec += step_ns / 1000000000LL;
+        next.tv_nsec += step_ns % 1000000000LL;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
+        }
+    }
+    free(t.seen);
+    return 0;
+}
+
+/**
+ * @brief Se desliga de la terminal (fork doble y setsid) y escribe en `log_path`.
+ * @return 0 en el proceso demonio; los procesos intermedios terminan aquí.
+ */
+static int detach(const char *log_path) {
+    int log_fd = open(log_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_fd == -1) {
+        perror(log_path);
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid > 0) exit(EXIT_SUCCESS);
+    if (setsid() < 0) {
+        perror("setsid");
+        return -1;
+    }
+    pid = fork(); // El demonio no es líder de sesión: nunca adquiere una terminal
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid > 0) exit(EXIT_SUCCESS);
+
+    if (chdir("/") < 0) perror("chdir /");
+    int null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (null_fd != -1) {
+        dup2(null_fd, STDIN_FILENO);
+        close(null_fd);
+    }
+    dup2(log_fd, STDOUT_FILENO);
+    dup2(log_fd, STDERR_FILENO);
+    close(log_fd);
+    return 0;
+}
+
+// --- Salida para máquinas: --format=jsonl|csv|binary ---
+
+typedef enum {
+    FORMAT_TEXT = 0, // Reporte para humanos (comportamiento original)
+    FORMAT_JSONL,
+    FORMAT_CSV,
+    FORMAT_BINARY
+} output_format_t;
+
+// Escritor con buffer propio: los registros se acumulan y salen en pocos write()
+typedef struct {
+    int fd;
+    size_t len;
+    char buf[OUT_BUF_SIZE];
+} out_writer_t;
+
+// Formato binario (orden de bytes nativo). Cada foto es una cabecera seguida de
+// `count` registros de tamaño fijo `record_size`.
+typedef struct {
+    uint32_t magic;        // BINARY_MAGIC
+    uint16_t version;      // BINARY_VERSION
+    uint16_t record_size;  // sizeof(binary_record_t)
+    uint32_t count;        // Registros que siguen
+    uint32_t reserved;
+    uint64_t ts_ms;        // Instante de la foto (ms desde epoch)
+} binary_header_t;
+
+typedef struct {
+    int32_t pid;
+    int32_t ppid;
+    int64_t cputime_sec;
+    char state;
+    char reserved[7];
+    char comm[COMM_LEN];        // Terminado en '\0'
+    char parent_comm[COMM_LEN]; // "" si el padre ya no existe
+} binary_record_t;
+
+static int out_flush(out_writer_t *out) {
+    size_t off = 0;
+    while (off < out->len) {
+        ssize_t n = write(out->fd, out->buf + off, out->len - off);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("write");
+            return -1;
+        }
+        off += (size_t) n;
+    }
+    out->len = 0;
+    return 0;
+}
+
+/**
+ * @brief Copia `len` bytes al buffer (len nunca supera un registro, << OUT_BUF_SIZE).
+ */
+static void out_write(out_writer_t *out, const void *data, size_t len) {
+    if (out->len + len > sizeof(out->buf)) out_flush(out);
+    memcpy(out->buf + out->len, data, len);
+    out->len += len;
+}
+
+static void out_printf(out_writer_t *out, const char *fmt, ...) {
+    char line[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n > 0) out_write(out, line, (size_t) n < sizeof(line) ? (size_t) n : sizeof(line) - 1);
+}
+
+/**
+ * @brief Escribe una cadena JSON con escapes (el comm puede contener comillas o controles).
+ */
+static void out_json_string(out_writer_t *out, const char *str) {
+    char esc[4 * COMM_LEN + 2 + 6 * COMM_LEN];
+    size_t n = 0;
+    esc[n++] = '"';
+    for (const unsigned char *p = (const unsigned char *) str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            esc[n++] = '\\';
+            esc[n++] = (char) *p;
+        } else if (*p < 0x20) {
+            n += (size_t) snprintf(esc + n, 7, "\\u%04x", *p);
+        } else {
+            esc[n++] = (char) *p;
+        }
+    }
+    esc[n++] = '"';
+    out_write(out, esc, n);
+}
+
+/**
+ * @brief Escribe un campo CSV entre comillas (las comillas internas se duplican).
+ */
+static void out_csv_string(out_writer_t *out, const char *str) {
+    char esc[2 * COMM_LEN + 2];
+    size_t n = 0;
+    esc[n++] = '"';
+    for (const char *p = str; *p; p++) {
+        if (*p == '"') esc[n++] = '"';
+        esc[n++] = *p;
+    }
+    esc[n++] = '"';
+    out_write(out, esc, n);
+}
+
+static uint64_t realtime_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + (uint64_t)(ts.tv_nsec / 1000000);
+}
+
+/**
+ * @brief Emite una foto en el formato pedido.
+ * Esquema estable: ts_ms, pid, ppid, comm, state, cputime_sec, parent_comm.
+ */
+static void write_snapshot(out_writer_t *out, output_format_t format, const zombie_list_t *zombie_list) {
+    uint64_t ts = realtime_ms();
+    int cached_ppid = -1;
+    char parent_comm[COMM_LEN] = "";
+
+    if (format == FORMAT_BINARY) {
+        binary_header_t header = {BINARY_MAGIC, BINARY_VERSION, sizeof(binary_record_t),
+                                  (uint32_t) zombie_list->total, 0, ts};
+        out_write(out, &header, sizeof(header));
+    }
+
+    for (const zombie_chunk_t *chunk = zombie_list->head; chunk; chunk = chunk->next) {
+        for (int i = 0; i < chunk->count; i++) {
+            const zombie_info_t *z = &chunk->items[i];
+
+            // Los hermanos suelen ser contiguos en /proc: basta con recordar el último padre
+            if (z->ppid != cached_ppid) {
+                proc_stat_t parent;
+                cached_ppid = z->ppid;
+                if (read_proc_stat(z->ppid, &parent) == 0) {
+                    strcpy(parent_comm, parent.comm);
+                } else {
+                    parent_comm[0] = '\0';
+                }
+            }
+
+            if (format == FORMAT_JSONL) {
+                out_printf(out, "{\"ts_ms\":%llu,\"pid\":%d,\"ppid\":%d,\"comm\":",
+                           (unsigned long long) ts, z->pid, z->ppid);
+                out_json_string(out, z->command);
+                out_printf(out, ",\"state\":\"Z\",\"cputime_sec\":%ld,\"parent_comm\":", z->cputime_sec);
+                out_json_string(out, parent_comm);
+                out_write(out, "}\n", 2);
+            } else if (format == FORMAT_CSV) {
+                out_printf(out, "%llu,%d,%d,", (unsigned long long) ts, z->pid, z->ppid);
+                out_csv_string(out, z->command);
+                out_printf(out, ",Z,%ld,", z->cputime_sec);
+                out_csv_string(out, parent_comm);
+                out_write(out, "\n", 1);
+            } else {
+                binary_record_t rec;
+                memset(&rec, 0, sizeof(rec));
+                rec.pid = z->pid;
+                rec.ppid = z->ppid;
+                rec.cputime_sec = z->cputime_sec;
+                rec.state = 'Z';
+                strcpy(rec.comm, z->command);
+                strcpy(rec.parent_comm, parent_comm);
+                out_write(out, &rec, sizeof(rec));
+            }
+        }
+    }
+    out_flush(out);
+}
+
+static int parse_format(const char *name, output_format_t *format) {
+    if (strcmp(name, "text") == 0) *format = FORMAT_TEXT;
+    else if (strcmp(name, "jsonl") == 0) *format = FORMAT_JSONL;
+    else if (strcmp(name, "csv") == 0) *format = FORMAT_CSV;
+    else if (strcmp(name, "binary") == 0) *format = FORMAT_BINARY;
+    else return -1;
+    return 0;
+}
+
+/**
+ * @brief Imprime el uso en stderr.
+ * @return Código de salida de error (1).
+ */
+static int usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [-j hilos] [--watch] [--format=text|jsonl|csv|binary]\n"
+                    "       [--interval=segundos [--count=N]] [-o|--output=archivo]\n"
+                    "       --track [--interval=segundos] [--alert-rate=zombies/s] [--daemon] [-o archivo]\n",
+            prog);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    zombie_list_t zombie_list = {NULL, NULL, 0};
+    int num_threads = 1;
+    int watch = 0;
+    int track = 0;
+    int detach_mode = 0;
+    double alert_rate = TRACK_DEFAULT_RATE;
+    int alert_set = 0;
+    output_format_t format = FORMAT_TEXT;
+    double interval = 0;  // Segundos entre fotos (0 = una sola foto)
+    long count = 0;       // Número de fotos con --interval (0 = sin fin)
+    const char *output_path = NULL;
+    int opt;
+    static const struct option long_options[] = {
+        {"watch", no_argument, NULL, 'w'},
+        {"format", required_argument, NULL, 'f'},
+        {"interval", required_argument, NULL, 'i'},
+        {"count", required_argument, NULL, 'n'},
+        {"output", required_argument, NULL, 'o'},
+        {"track", no_argument, NULL, 't'},
+        {"alert-rate", required_argument, NULL, 'a'},
+        {"daemon", no_argument, NULL, 'd'},
+        {NULL, 0, NULL, 0}
+    };
+
+    // -j N: escaneo paralelo con N hilos (0 = uno por CPU en línea)
+    // --watch: reporte inicial y después eventos del kernel (fork/exit) sin sondear /proc
+    // --format/--interval/--count/--output: fotos periódicas para monitoreo
+    // --track [--alert-rate=R] [--daemon]: tasa de fuga por padre con alertas (memoria acotada)
+    while ((opt = getopt_long(argc, argv, "j:o:", long_options, NULL)) != -1) {
+        if (opt == 'j') {
+            num_threads = atoi(optarg);
+            if (num_threads <= 0) num_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+            if (num_threads > MAX_SCAN_THREADS) num_threads = MAX_SCAN_THREADS;
+        } else if (opt == 'w') {
+            watch = 1;
+        } else if (opt == 'f' && parse_format(optarg, &format) == 0) {
+            continue;
+        } else if (opt == 'i' && (interval = atof(optarg)) > 0) {
+            continue;
+        } else if (opt == 'n' && (count = atol(optarg)) > 0) {
+            continue;
+        } else if (opt == 'o') {
+            output_path = optarg;
+        } else if (opt == 't') {
+            track = 1;
+        } else if (opt == 'a' && (alert_rate = atof(optarg)) > 0) {
+            alert_set = 1;
+        } else if (opt == 'd') {
+            detach_mode = 1;
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    // --daemon y --alert-rate solo tienen sentido con --track
+    if ((detach_mode || alert_set) && !track) {
+        return usage(argv[0]);
+    }
+
+    if (watch) {
+        return run_watch();
+    }
+
+    if (track) {
+        if (detach_mode && detach(output_path ? output_path : TRACK_LOG_FILE) == -1) return 1;
+        if (!detach_mode && output_path && !freopen(output_path, "a", stdout)) {
+            perror(output_path);
+            return 1;
+        }
+        return run_track(interval > 0 ? interval : 1.0, count, alert_rate);
+    }
+
+    static out_writer_t out;
+    out.fd = STDOUT_FILENO;
+    if (output_path) {
+        out.fd = open(output_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (out.fd == -1) {
+            perror(output_path);
+            return 1;
+        }
+        if (format == FORMAT_TEXT && dup2(out.fd, STDOUT_FILENO) == -1) {
+            perror("dup2");
+            return 1;
+        }
+    }
+    if (format == FORMAT_CSV) {
+        out_printf(&out, "ts_ms,pid,ppid,comm,state,cputime_sec,parent_comm\n");
+    }
+
+    // Las fotos se programan con plazos absolutos: el coste del escaneo no acumula deriva
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (long taken = 0; ; taken++) {
+        // 1. Escanear y encontrar zombies
+        if (format == FORMAT_TEXT) {
+            // El reporte para humanos construye el árbol completo en el mismo escaneo
+            proc_index_t index = {0};
+            find_zombies(&zombie_list, num_threads, &index);
+            if (proc_index_build(&index) == -1) {
+                perror("proc_index_build");
+                proc_index_free(&index);
+                print_report(&zombie_list, NULL);
+            } else {
+                print_report(&zombie_list, &index);
+                proc_index_free(&index);
+            }
+            fflush(stdout);
+        } else {
+            find_zombies(&zombie_list, num_threads, NULL);
+            write_snapshot(&out, format, &zombie_list);
+        }
+        zombie_list_free(&zombie_list);
+
+        if (interval <= 0 || (count > 0 && taken + 1 >= count)) break;
+
+        long long step_ns = (long long)(interval * 1e9);
+        next.tv_sec += step_ns / 1000000000LL;
+        next.tv_nsec += step_ns % 1000000000LL;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
+        }
+    }
 
     return 0;
 }
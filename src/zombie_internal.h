@@ -0,0 +1,25 @@
+#ifndef ZOMBIE_INTERNAL_H
+#define ZOMBIE_INTERNAL_H
+
+/**
+ * @brief Definiciones internas de libzombie compartidas con tests/test_lib.c.
+ * No forman parte de la API pública: pueden cambiar entre versiones sin aviso.
+ */
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Registro de hijos (pid -> spawn, estado de salida): tabla hash de direccionamiento
+// abierto sobre un arreglo preasignado, sin reservas de memoria en el camino caliente.
+#define REGISTRY_SLOTS 16384      // Potencia de dos
+#define REGISTRY_PROBES 32        // Ventana máxima de sondeo lineal (O(1) acotado)
+#define REGISTRY_HASH_MUL 2654435761u // Hash multiplicativo de Knuth
+
+/**
+ * @brief Ranura inicial de la ventana de sondeo de un PID en el registro de hijos.
+ */
+static inline unsigned int zombie_registry_hash(pid_t pid) {
+    return ((uint32_t) pid * REGISTRY_HASH_MUL) & (REGISTRY_SLOTS - 1);
+}
+
+#endif
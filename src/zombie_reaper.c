@@ -1,11 +1,38 @@
+#define _GNU_SOURCE // pidfd_open (syscall), epoll, signalfd, prctl y MAP_ANONYMOUS
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <sys/prctl.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <errno.h>
 
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434 // Igual en todas las arquitecturas (Linux >= 5.3)
+#endif
+
+// Modo --bench
+#define BENCH_MAX_CHILDREN 100000
+#define BENCH_DEFAULT_CHILDREN 10000
+#define BENCH_DEFAULT_BATCH 1000 // Hijos vivos a la vez (limitado por pid_max, ulimit -u y ulimit -n)
+#define BENCH_EPOLL_BATCH 256
+
+// Modo --subreaper
+#define SUBREAPER_SIGINFO_BATCH 32
+#define SUBREAPER_LAT_BUCKETS 40 // Histograma log2 en ns: hasta ~9 minutos
+#define SUBREAPER_USAGE_MAX 64   // Comandos distintos en la tabla de consumo
+#define USAGE_COMM_LEN 16        // TASK_COMM_LEN
+
 // --- Strategy 1: Explicit Wait ---
 
 /**
@@ -16,14 +43,16 @@ void reap_explicit(void) {
     printf("--- Strategy 1: Explicit Wait (waitpid) ---\n");
     int status;
     pid_t pid;
+    struct rusage ru;
     int reaped_count = 0;
 
-    // waitpid(-1, &status, WNOHANG) intenta cosechar cualquier hijo.
+    // wait4(-1, &status, WNOHANG, &ru) intenta cosechar cualquier hijo y devuelve su consumo.
     // > 0 significa que un hijo fue cosechado.
     // Bucle para asegurar que se cosechan todos los hijos que terminaron.
-    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
-        printf("  [Reaper - Explicit]: Reaped child PID %d with exit code %d.\n", 
-               pid, WEXITSTATUS(status));
+    while ((pid = wait4(-1, &status, WNOHANG, &ru)) > 0) {
+        printf("  [Reaper - Explicit]: Reaped child PID %d with exit code %d (user %.3fs, sys %.3fs, maxrss %ld KB).\n",
+               pid, WEXITSTATUS(status), ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6,
+               ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6, ru.ru_maxrss);
         reaped_count++;
     }
 
@@ -43,15 +72,16 @@ void reap_explicit(void) {
 void sigchld_handler(int /*sig*/) {
     int status;
     pid_t pid;
+    struct rusage ru;
 
     // IMPORTANTE: Se utiliza un bucle while para cosechar *todos* los hijos 
     // que terminaron desde la última señal, previniendo race conditions 
     // donde múltiples hijos terminan antes de que el handler se ejecute.
-    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+    while ((pid = wait4(-1, &status, WNOHANG, &ru)) > 0) {
         // En un daemon o aplicación de larga duración, usaríamos write() o syslog 
         // en lugar de printf() dentro del signal handler, pero para la demostración 
         // de la prueba se usa printf().
-        printf("  [Reaper - Handler]: Reaped child PID %d (Async).\n", pid);
+        printf("  [Reaper - Handler]: Reaped child PID %d (Async, maxrss %ld KB).\n", pid, ru.ru_maxrss);
     }
 
     if (pid == -1 && errno != ECHILD) {
@@ -93,13 +123,562 @@ void setup_ignore_reaper(void) {
         perror("signal SIG_IGN");
         exit(EXIT_FAILURE);
     }
+    // SIG_IGN solo afecta a las salidas futuras: los hijos que ya terminaron siguen zombies
+    while (waitpid(-1, NULL, WNOHANG) > 0) {
+    }
     printf("SIGCHLD set to SIG_IGN. Children will be automatically reaped by kernel.\n");
 }
 
+// --- Modo --bench: comparación de estrategias de cosecha ---
+
+typedef enum {
+    BENCH_WAITPID = 0, // waitpid(-1, ..., 0) bloqueante
+    BENCH_HANDLER,     // Handler de SIGCHLD con bucle WNOHANG
+    BENCH_SIGIGN,      // SIGCHLD = SIG_IGN: el kernel descarta a los hijos (sin evento de cosecha)
+    BENCH_SIGNALFD,    // SIGCHLD bloqueado y leído por signalfd
+    BENCH_PIDFD,       // Un pidfd por hijo en un epoll
+    BENCH_STRATEGIES
+} bench_strategy_t;
+
+static const char *const bench_names[BENCH_STRATEGIES] = {"waitpid", "handler", "sigign", "signalfd", "pidfd"};
+
+// Parámetros y estado compartido de una corrida
+typedef struct {
+    int children;      // Total de hijos (hasta BENCH_MAX_CHILDREN)
+    int batch;         // Hijos vivos a la vez
+    long spread_us;    // Las salidas de un lote se reparten uniformemente en este intervalo
+    int *slot_of_pid;  // pid -> índice en el lote (calloc(pid_max + 1))
+    int pid_max;
+    pid_t *pids;       // PIDs del lote actual
+    uint64_t *shared;  // MAP_SHARED: [0] = instante de liberación, [1 + k] = instante de salida del hijo k
+    uint64_t *reap_ns; // Instante de cosecha del hijo k (0 = aún no cosechado)
+    int *pidfds;       // Estrategia pidfd: descriptor del hijo k (se cierra tras la cosecha)
+} bench_run_t;
+
+static bench_run_t *bench_active; // Para el handler de SIGCHLD
+static volatile sig_atomic_t bench_reaped;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Registra la cosecha de `pid` (async-signal-safe: solo escribe en arreglos ya reservados).
+ */
+static void bench_record(bench_run_t *run, pid_t pid, uint64_t when) {
+    if (pid > 0 && pid <= run->pid_max) {
+        run->reap_ns[run->slot_of_pid[pid]] = when;
+    }
+}
+
+static void bench_sigchld_handler(int sig) {
+    (void) sig;
+    int saved_errno = errno;
+    pid_t pid;
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        bench_record(bench_active, pid, now_ns());
+        bench_reaped = bench_reaped + 1;
+    }
+    errno = saved_errno;
+}
+
+/**
+ * @brief Hijo del benchmark: espera la liberación del lote y termina en su instante programado.
+ */
+static void bench_child(bench_run_t *run, int slot, int release_fd) {
+    char c;
+    while (read(release_fd, &c, 1) > 0) {
+    }
+    uint64_t deadline = run->shared[0] + (uint64_t) run->spread_us * 1000ull * (uint64_t) slot / (uint64_t) run->batch;
+    struct timespec ts = {(time_t)(deadline / 1000000000ull), (long)(deadline % 1000000000ull)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+    run->shared[1 + slot] = now_ns();
+    _exit(0);
+}
+
+/**
+ * @brief Crea y cosecha un lote de `count` hijos con la estrategia dada.
+ * @return Nanosegundos desde la liberación hasta la última cosecha, o 0 en error.
+ */
+static uint64_t bench_batch(bench_run_t *run, bench_strategy_t strategy, int count, int epfd, int sfd) {
+    int release[2];
+    if (pipe(release) == -1) {
+        perror("pipe");
+        return 0;
+    }
+
+    memset(run->reap_ns, 0, (size_t) count * sizeof(uint64_t));
+    bench_reaped = 0;
+    for (int k = 0; k < count; k++) {
+        pid_t pid = fork();
+        if (pid == -1) {
+            perror("fork (aumente ulimit -u o reduzca --batch)");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0) {
+            close(release[1]);
+            bench_child(run, k, release[0]);
+        }
+        run->pids[k] = pid;
+        run->slot_of_pid[pid] = k;
+
+        if (strategy == BENCH_PIDFD) {
+            int fd = (int) syscall(SYS_pidfd_open, pid, 0);
+            struct epoll_event ev = {.events = EPOLLIN, .data.u32 = (uint32_t) k};
+            if (fd == -1 || epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+                perror("pidfd_open/epoll_ctl (¿Linux >= 5.3? ¿ulimit -n?)");
+                exit(EXIT_FAILURE);
+            }
+            run->pidfds[k] = fd;
+        }
+    }
+
+    // Liberar el lote: todos los hijos ven EOF a la vez
+    close(release[0]);
+    uint64_t start = now_ns();
+    run->shared[0] = start;
+    close(release[1]);
+
+    int reaped = 0;
+    pid_t pid;
+    switch (strategy) {
+    case BENCH_WAITPID:
+        while (reaped < count && (pid = waitpid(-1, NULL, 0)) > 0) {
+            bench_record(run, pid, now_ns());
+            reaped++;
+        }
+        break;
+    case BENCH_HANDLER: {
+        // SIGCHLD bloqueado salvo dentro de sigsuspend(): no se pierde ninguna señal
+        sigset_t block, orig;
+        sigemptyset(&block);
+        sigaddset(&block, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &block, &orig);
+        while (bench_reaped < count) sigsuspend(&orig);
+        sigprocmask(SIG_SETMASK, &orig, NULL);
+        break;
+    }
+    case BENCH_SIGIGN:
+        // Con SIG_IGN, wait() bloquea hasta que no quedan hijos y falla con ECHILD
+        while (waitpid(-1, NULL, 0) != -1 || errno == EINTR) {
+        }
+        break;
+    case BENCH_SIGNALFD: {
+        struct signalfd_siginfo info[64];
+        while (reaped < count) {
+            if (read(sfd, info, sizeof(info)) == -1 && errno != EINTR) {
+                perror("read signalfd");
+                break;
+            }
+            while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+                bench_record(run, pid, now_ns());
+                reaped++;
+            }
+        }
+        break;
+    }
+    case BENCH_PIDFD: {
+        struct epoll_event events[BENCH_EPOLL_BATCH];
+        while (reaped < count) {
+            int n = epoll_wait(epfd, events, BENCH_EPOLL_BATCH, -1);
+            for (int i = 0; i < n; i++) {
+                int k = (int) events[i].data.u32;
+                // Solo se cosecha el hijo cuyo pidfd está listo: sin waitpid(-1)
+                if (waitpid(run->pids[k], NULL, 0) > 0) {
+                    bench_record(run, run->pids[k], now_ns());
+                    reaped++;
+                }
+                // Los hijos lanzados después en la misma ronda heredan copias de los
+                // pidfds: close() no basta para retirarlo del epoll
+                epoll_ctl(epfd, EPOLL_CTL_DEL, run->pidfds[k], NULL);
+                close(run->pidfds[k]);
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return now_ns() - start;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Ejecuta una estrategia completa e imprime su fila CSV.
+ * Se llama en un proceso dedicado: la disposición de SIGCHLD no contamina a las demás.
+ */
+static int bench_strategy(bench_strategy_t strategy, int children, int batch, long spread_us) {
+    bench_run_t run = {children, batch, spread_us, NULL, 0, NULL, NULL, NULL, NULL};
+    FILE *fp = fopen("/proc/sys/kernel/pid_max", "r");
+    run.pid_max = 4194304;
+    if (fp) {
+        if (fscanf(fp, "%d", &run.pid_max) != 1) run.pid_max = 4194304;
+        fclose(fp);
+    }
+
+    uint64_t *latencies = malloc((size_t) children * sizeof(uint64_t));
+    run.slot_of_pid = calloc((size_t) run.pid_max + 1, sizeof(int));
+    run.pids = malloc((size_t) batch * sizeof(pid_t));
+    run.reap_ns = malloc((size_t) batch * sizeof(uint64_t));
+    run.pidfds = malloc((size_t) batch * sizeof(int));
+    // Compartido con los hijos: instante de liberación e instante de salida de cada uno
+    run.shared = mmap(NULL, (1 + (size_t) batch) * sizeof(uint64_t), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (!latencies || !run.slot_of_pid || !run.pids || !run.reap_ns || !run.pidfds || run.shared == MAP_FAILED) {
+        perror("bench alloc");
+        return 1;
+    }
+
+    int epfd = -1, sfd = -1;
+    if (strategy == BENCH_HANDLER) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = bench_sigchld_handler;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+        bench_active = &run;
+        sigaction(SIGCHLD, &sa, NULL);
+    } else if (strategy == BENCH_SIGIGN) {
+        signal(SIGCHLD, SIG_IGN);
+    } else if (strategy == BENCH_SIGNALFD) {
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &mask, NULL);
+        sfd = signalfd(-1, &mask, SFD_CLOEXEC);
+    } else if (strategy == BENCH_PIDFD) {
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        // Un pidfd por hijo vivo: se sube el límite blando de descriptores al duro
+        struct rlimit rl;
+        if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+            rl.rlim_cur = rl.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &rl);
+        }
+    }
+    if ((strategy == BENCH_SIGNALFD && sfd == -1) || (strategy == BENCH_PIDFD && epfd == -1)) {
+        perror(bench_names[strategy]);
+        return 1;
+    }
+
+    uint64_t total_ns = 0;
+    int n_lat = 0;
+    for (int done = 0; done < children; ) {
+        int count = children - done < batch ? children - done : batch;
+        uint64_t elapsed = bench_batch(&run, strategy, count, epfd, sfd);
+        if (elapsed == 0) return 1;
+        total_ns += elapsed;
+        for (int k = 0; k < count; k++) {
+            uint64_t exited = run.shared[1 + k];
+            if (run.reap_ns[k] != 0 && exited != 0) {
+                latencies[n_lat++] = run.reap_ns[k] > exited ? run.reap_ns[k] - exited : 0;
+            }
+        }
+        done += count;
+    }
+
+    // Con SIG_IGN no hay evento de cosecha: solo se reporta el throughput
+    double seconds = (double) total_ns / 1e9;
+    printf("%s,%d,%d,%ld,%.4f,%.0f", bench_names[strategy], children, batch, spread_us, seconds,
+           seconds > 0 ? children / seconds : 0.0);
+    if (n_lat > 0) {
+        qsort(latencies, (size_t) n_lat, sizeof(uint64_t), compare_u64);
+        printf(",%.1f,%.1f,%.1f,%.1f\n", latencies[(size_t) n_lat * 50 / 100] / 1e3,
+               latencies[(size_t) n_lat * 90 / 100] / 1e3, latencies[(size_t) n_lat * 99 / 100] / 1e3,
+               latencies[n_lat - 1] / 1e3);
+    } else {
+        printf(",,,,\n");
+    }
+    fflush(stdout);
+    return 0;
+}
+
+static int bench_usage(const char *prog) {
+    fprintf(stderr, "Uso: %s --bench [-n hijos] [-b lote] [-s dispersion_us] [estrategia ...]\n", prog);
+    fprintf(stderr, "Estrategias: waitpid, handler, sigign, signalfd, pidfd (por defecto, todas)\n");
+    return 1;
+}
+
+/**
+ * @brief Modo --bench: una fila CSV por estrategia, cada una en un proceso nuevo.
+ */
+static int run_bench(int argc, char *argv[], const char *prog) {
+    int children = BENCH_DEFAULT_CHILDREN;
+    int batch = BENCH_DEFAULT_BATCH;
+    long spread_us = 0;
+    int selected[BENCH_STRATEGIES] = {0};
+    int any = 0, opt;
+
+    while ((opt = getopt(argc, argv, "n:b:s:")) != -1) {
+        if (opt == 'n') children = atoi(optarg);
+        else if (opt == 'b') batch = atoi(optarg);
+        else if (opt == 's') spread_us = atol(optarg);
+        else return bench_usage(prog);
+    }
+    if (children <= 0 || children > BENCH_MAX_CHILDREN || batch <= 0 || spread_us < 0) {
+        return bench_usage(prog);
+    }
+    if (batch > children) batch = children;
+
+    for (int i = optind; i < argc; i++) {
+        int s = 0;
+        while (s < BENCH_STRATEGIES && strcmp(argv[i], bench_names[s]) != 0) s++;
+        if (s == BENCH_STRATEGIES) return bench_usage(prog);
+        selected[s] = any = 1;
+    }
+
+    printf("strategy,children,batch,spread_us,seconds,reaps_per_sec,p50_us,p90_us,p99_us,max_us\n");
+    fflush(stdout);
+    for (int s = 0; s < BENCH_STRATEGIES; s++) {
+        if (any && !selected[s]) continue;
+        pid_t runner = fork();
+        if (runner == -1) {
+            perror("fork");
+            return 1;
+        }
+        if (runner == 0) _exit(bench_strategy((bench_strategy_t) s, children, batch, spread_us));
+        int status;
+        if (waitpid(runner, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "La estrategia %s falló.\n", bench_names[s]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+// --- Modo --subreaper: init mínimo que adopta a los descendientes huérfanos ---
+
+// Señales que se reenvían a la carga de trabajo
+static const int subreaper_forwarded[] = {SIGHUP, SIGINT, SIGQUIT, SIGTERM, SIGUSR1, SIGUSR2, SIGWINCH, SIGCONT};
+
+// Consumo acumulado (wait4) de los descendientes con un mismo comm
+typedef struct {
+    char command[USAGE_COMM_LEN];
+    unsigned long long reaped;
+    unsigned long long utime_us;
+    unsigned long long stime_us;
+    long maxrss_kb;
+    unsigned long long nvcsw;
+    unsigned long long nivcsw;
+} subreaper_usage_t;
+
+// Estadísticas de cosecha; la latencia va a un histograma log2 (memoria fija)
+typedef struct {
+    unsigned long long reaped;
+    unsigned long long orphans;           // Descendientes que no eran hijos directos
+    unsigned long long batches;
+    unsigned long long max_batch;
+    unsigned long long latency_hist[SUBREAPER_LAT_BUCKETS]; // Bucket b: latencia < 2^b ns
+    subreaper_usage_t usage[SUBREAPER_USAGE_MAX];
+    int usage_rows;
+    unsigned long long usage_dropped;     // Descendientes de comandos que no cupieron
+} subreaper_stats_t;
+
+/**
+ * @brief Lee el comm de un descendiente terminado y aún no cosechado.
+ */
+static void child_comm(pid_t pid, char comm[USAGE_COMM_LEN]) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/comm", (int) pid);
+
+    ssize_t got = -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+        got = read(fd, comm, USAGE_COMM_LEN - 1);
+        close(fd);
+    }
+    if (got <= 0) {
+        strcpy(comm, "(unknown)");
+        return;
+    }
+    if (comm[got - 1] == '\n') got--;
+    comm[got] = '\0';
+}
+
+static void subreaper_record_usage(subreaper_stats_t *st, const char *comm, const struct rusage *ru) {
+    int row = 0;
+    while (row < st->usage_rows && strcmp(st->usage[row].command, comm) != 0) row++;
+    if (row == st->usage_rows) {
+        if (st->usage_rows == SUBREAPER_USAGE_MAX) {
+            st->usage_dropped++;
+            return;
+        }
+        strcpy(st->usage[row].command, comm);
+        st->usage_rows++;
+    }
+
+    subreaper_usage_t *u = &st->usage[row];
+    u->reaped++;
+    u->utime_us += (unsigned long long) ru->ru_utime.tv_sec * 1000000 + (unsigned long long) ru->ru_utime.tv_usec;
+    u->stime_us += (unsigned long long) ru->ru_stime.tv_sec * 1000000 + (unsigned long long) ru->ru_stime.tv_usec;
+    if (ru->ru_maxrss > u->maxrss_kb) u->maxrss_kb = ru->ru_maxrss;
+    u->nvcsw += (unsigned long long) ru->ru_nvcsw;
+    u->nivcsw += (unsigned long long) ru->ru_nivcsw;
+}
+
+static void subreaper_record_latency(subreaper_stats_t *st, uint64_t ns) {
+    int b = 0;
+    while (b < SUBREAPER_LAT_BUCKETS - 1 && ns >= (1ull << b)) b++;
+    st->latency_hist[b]++;
+}
+
+/**
+ * @brief Percentil aproximado (cota superior del bucket) en microsegundos.
+ */
+static double subreaper_percentile(const subreaper_stats_t *st, double pct) {
+    unsigned long long target = (unsigned long long)(pct / 100.0 * (double) st->reaped);
+    unsigned long long seen = 0;
+    for (int b = 0; b < SUBREAPER_LAT_BUCKETS; b++) {
+        seen += st->latency_hist[b];
+        if (seen > target) return (double)(1ull << b) / 1e3;
+    }
+    return 0.0;
+}
+
+/**
+ * @brief Cosecha por lotes a todos los descendientes terminados (hijos directos y huérfanos adoptados).
+ * @return 1 si entre ellos estaba la carga de trabajo (su estado queda en *workload_status).
+ */
+static int subreaper_reap(subreaper_stats_t *st, pid_t workload, int *workload_status, uint64_t woke_ns) {
+    unsigned long long batch = 0;
+    int workload_done = 0, status;
+    pid_t pid;
+
+    // waitid(WNOWAIT) identifica al descendiente sin cosecharlo: su comm aún puede leerse
+    for (;;) {
+        siginfo_t info;
+        struct rusage ru;
+        char comm[USAGE_COMM_LEN];
+        info.si_pid = 0;
+        if (waitid(P_ALL, 0, &info, WEXITED | WNOHANG | WNOWAIT) == -1 || info.si_pid == 0) break;
+        child_comm(info.si_pid, comm);
+        if ((pid = wait4(info.si_pid, &status, WNOHANG, &ru)) <= 0) break;
+
+        subreaper_record_latency(st, now_ns() - woke_ns);
+        subreaper_record_usage(st, comm, &ru);
+        batch++;
+        if (pid == workload) {
+            *workload_status = status;
+            workload_done = 1;
+        } else {
+            st->orphans++;
+        }
+    }
+    if (batch > 0) {
+        st->reaped += batch;
+        st->batches++;
+        if (batch > st->max_batch) st->max_batch = batch;
+    }
+    return workload_done;
+}
+
+/**
+ * @brief Modo --subreaper: lanza `cmd`, reenvía señales y cosecha a todos sus descendientes.
+ * Termina cuando termina la carga de trabajo; los descendientes aún vivos pasan al ancestro.
+ * @return Código de salida de la carga (128 + señal si la mató una señal).
+ */
+static int run_subreaper(char *cmd[]) {
+    subreaper_stats_t st;
+    memset(&st, 0, sizeof(st));
+
+    if (prctl(PR_SET_CHILD_SUBREAPER, 1, 0, 0, 0) == -1) {
+        perror("prctl PR_SET_CHILD_SUBREAPER");
+        return 1;
+    }
+
+    // Bloquear antes del fork: ninguna señal llega antes de que la carga exista
+    sigset_t mask, orig;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    for (size_t i = 0; i < sizeof(subreaper_forwarded) / sizeof(subreaper_forwarded[0]); i++) {
+        sigaddset(&mask, subreaper_forwarded[i]);
+    }
+    sigprocmask(SIG_BLOCK, &mask, &orig);
+    int sfd = signalfd(-1, &mask, SFD_CLOEXEC);
+    if (sfd == -1) {
+        perror("signalfd");
+        return 1;
+    }
+
+    pid_t workload = fork();
+    if (workload == -1) {
+        perror("fork");
+        return 1;
+    }
+    if (workload == 0) {
+        sigprocmask(SIG_SETMASK, &orig, NULL);
+        execvp(cmd[0], cmd);
+        perror(cmd[0]);
+        _exit(127);
+    }
+
+    int status = 0;
+    struct signalfd_siginfo info[SUBREAPER_SIGINFO_BATCH];
+    for (;;) {
+        ssize_t n = read(sfd, info, sizeof(info));
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("read signalfd");
+            return 1;
+        }
+        uint64_t woke = now_ns();
+
+        int chld = 0;
+        for (size_t i = 0; i < (size_t) n / sizeof(info[0]); i++) {
+            if (info[i].ssi_signo == SIGCHLD) {
+                chld = 1;
+            } else {
+                kill(workload, (int) info[i].ssi_signo);
+            }
+        }
+        // SIGCHLD se fusiona: una sola lectura puede representar muchos descendientes
+        if (chld && subreaper_reap(&st, workload, &status, woke)) break;
+    }
+
+    fprintf(stderr, "[subreaper] reaped %llu processes (%llu orphaned descendants) in %llu batches (max %llu); "
+                    "wake->reap latency p50 < %.1f us, p99 < %.1f us\n",
+            st.reaped, st.orphans, st.batches, st.max_batch, subreaper_percentile(&st, 50),
+            subreaper_percentile(&st, 99));
+    for (int i = 0; i < st.usage_rows; i++) {
+        const subreaper_usage_t *u = &st.usage[i];
+        fprintf(stderr, "[subreaper] usage '%s': %llu reaped, user %.3fs, sys %.3fs, maxrss %ld KB, csw %llu/%llu\n",
+                u->command, u->reaped, u->utime_us / 1e6, u->stime_us / 1e6, u->maxrss_kb, u->nvcsw, u->nivcsw);
+    }
+    if (st.usage_dropped > 0) {
+        fprintf(stderr, "[subreaper] usage: %llu descendants of untracked commands\n", st.usage_dropped);
+    }
+    close(sfd);
+
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return WEXITSTATUS(status);
+}
+
 
 int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+        return run_bench(argc - 1, argv + 1, argv[0]);
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--subreaper") == 0) {
+        int first = argc > 2 && strcmp(argv[2], "--") == 0 ? 3 : 2;
+        if (first >= argc) {
+            fprintf(stderr, "Uso: %s --subreaper -- <comando> [args ...]\n", argv[0]);
+            return 1;
+        }
+        return run_subreaper(argv + first);
+    }
+
     if (argc != 2) {
         fprintf(stderr, "Uso: %s <estrategia>\n", argv[0]);
+        fprintf(stderr, "       %s --bench [-n hijos] [-b lote] [-s dispersion_us] [estrategia ...]\n", argv[0]);
+        fprintf(stderr, "       %s --subreaper -- <comando> [args ...]\n", argv[0]);
         fprintf(stderr, "Estrategias: 1 (Explicit Wait), 2 (SIGCHLD Handler), 3 (SIG_IGN)\n");
         return 1;
     }
@@ -150,7 +729,9 @@ int main(int argc, char *argv[]) {
     // y el reaprocesamiento automático (estrategias 2 y 3) surta efecto.
     // Estrategia 1 ya cosechó, pero esperamos para verificar.
     printf("\nParent waiting for 5 seconds to allow all children to finish and reaping to occur...\n");
-    sleep(5);  
+    // sleep() retorna antes de tiempo con cada SIGCHLD atendido (estrategia 2): se reanuda
+    unsigned int remaining = 5;
+    while (remaining > 0) remaining = sleep(remaining);
     
     printf("\nVerification check (searching for 'defunct' processes):\n");
     // Verificar que no queden zombies
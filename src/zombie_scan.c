@@ -0,0 +1,170 @@
+#include "zombie.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+
+#define SCAN_STAT_BUF 4096      // /proc/[pid]/stat ocupa ~300 bytes; el comm admite hasta 64
+#define SCAN_INITIAL_CAPACITY 64
+
+struct zombie_scan_ctx {
+    int proc_fd;                  // /proc, abierto una vez
+    DIR *dir;                     // Sobre una copia de proc_fd; se rebobina en cada escaneo
+    zombie_scan_entry_t *zombies; // Arena de resultados: solo crece
+    size_t capacity;
+    char buf[SCAN_STAT_BUF];      // Buffer de lectura del stat
+};
+
+/**
+ * @brief Lee un entero decimal sin signo y avanza el cursor.
+ */
+static unsigned long long parse_ull(const char **cursor, const char *end) {
+    const char *p = *cursor;
+    unsigned long long value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (unsigned long long)(*p - '0');
+        p++;
+    }
+    *cursor = p;
+    return value;
+}
+
+/**
+ * @brief Salta `count` campos separados por espacios.
+ */
+static const char *skip_fields(const char *p, const char *end, int count) {
+    while (count-- > 0) {
+        while (p < end && *p != ' ') p++;
+        while (p < end && *p == ' ') p++;
+    }
+    return p;
+}
+
+int zombie_parse_stat(const char *buf, size_t len, zombie_proc_stat_t *stat) {
+    const char *end = buf + len;
+    const char *open_paren = memchr(buf, '(', len);
+    const char *close_paren = end - 1;
+    while (close_paren > buf && *close_paren != ')') close_paren--;
+    if (!open_paren || close_paren <= open_paren || close_paren + 4 > end) return -1;
+
+    size_t comm_len = (size_t)(close_paren - open_paren - 1);
+    if (comm_len >= sizeof(stat->comm)) comm_len = sizeof(stat->comm) - 1;
+    memcpy(stat->comm, open_paren + 1, comm_len);
+    stat->comm[comm_len] = '\0';
+
+    const char *q = buf;
+    stat->pid = (pid_t) parse_ull(&q, end);
+
+    // Tras ") ": campo 3 (state), 4 (ppid), ..., 14 (utime), 15 (stime), ..., 22 (starttime)
+    const char *p = close_paren + 2;
+    stat->state = *p;
+    p = skip_fields(p, end, 1);
+    stat->ppid = (pid_t) parse_ull(&p, end);
+    p = skip_fields(p, end, 10);
+    stat->utime = parse_ull(&p, end);
+    p = skip_fields(p, end, 1);
+    stat->stime = parse_ull(&p, end);
+    p = skip_fields(p, end, 7);
+    stat->start_time = parse_ull(&p, end);
+    return 0;
+}
+
+/**
+ * @brief Lee /proc/<name>/stat y, si el proceso es zombie, llena `entry`.
+ * @return 1 si es zombie, 0 si no lo es, -1 si ya no existe o no se pudo leer.
+ */
+static int scan_one(zombie_scan_ctx_t *ctx, const char *name, zombie_scan_entry_t *entry) {
+    char path[32];
+    size_t len = strlen(name);
+    if (len + sizeof("/stat") > sizeof(path)) return -1;
+    memcpy(path, name, len);
+    memcpy(path + len, "/stat", sizeof("/stat"));
+
+    int fd = openat(ctx->proc_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return -1;
+    ssize_t n;
+    do {
+        n = read(fd, ctx->buf, sizeof(ctx->buf));
+    } while (n == -1 && errno == EINTR);
+    close(fd);
+    if (n <= 0) return -1;
+
+    zombie_proc_stat_t stat;
+    if (zombie_parse_stat(ctx->buf, (size_t) n, &stat) != 0) return -1;
+    if (stat.state != 'Z') return 0;
+
+    entry->pid = stat.pid;
+    entry->ppid = stat.ppid;
+    entry->utime = stat.utime;
+    entry->stime = stat.stime;
+    entry->start_time = stat.start_time;
+    memcpy(entry->comm, stat.comm, sizeof(entry->comm));
+    return 1;
+}
+
+zombie_scan_ctx_t *zombie_scan_create(void) {
+    zombie_scan_ctx_t *ctx = calloc(1, sizeof(zombie_scan_ctx_t));
+    if (!ctx) return NULL;
+
+    ctx->proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    int dir_fd = ctx->proc_fd != -1 ? fcntl(ctx->proc_fd, F_DUPFD_CLOEXEC, 0) : -1;
+    ctx->dir = dir_fd != -1 ? fdopendir(dir_fd) : NULL;
+    ctx->capacity = SCAN_INITIAL_CAPACITY;
+    ctx->zombies = malloc(ctx->capacity * sizeof(zombie_scan_entry_t));
+
+    if (!ctx->dir || !ctx->zombies) {
+        int saved = errno;
+        if (!ctx->dir && dir_fd != -1) close(dir_fd);
+        zombie_scan_destroy(ctx);
+        errno = saved;
+        return NULL;
+    }
+    return ctx;
+}
+
+int zombie_scan(zombie_scan_ctx_t *ctx, zombie_scan_result_t *result) {
+    struct dirent *entry;
+    size_t count = 0, processes = 0;
+
+    if (!ctx || !result) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // rewinddir() reutiliza el buffer de getdents del DIR: sin opendir() por escaneo
+    rewinddir(ctx->dir);
+    for (;;) {
+        errno = 0; // readdir() solo señala errores a través de errno
+        entry = readdir(ctx->dir);
+        if (!entry) break;
+        if (entry->d_name[0] < '1' || entry->d_name[0] > '9') continue;
+
+        // El arena solo crece cuando hay más zombies que en cualquier escaneo previo
+        if (count == ctx->capacity) {
+            zombie_scan_entry_t *grown = realloc(ctx->zombies, 2 * ctx->capacity * sizeof(zombie_scan_entry_t));
+            if (!grown) return -1;
+            ctx->zombies = grown;
+            ctx->capacity *= 2;
+        }
+
+        int ret = scan_one(ctx, entry->d_name, &ctx->zombies[count]);
+        if (ret < 0) continue;
+        processes++;
+        if (ret == 1) count++;
+    }
+    if (errno != 0) return -1;
+
+    result->zombies = ctx->zombies;
+    result->count = count;
+    result->processes = processes;
+    return 0;
+}
+
+void zombie_scan_destroy(zombie_scan_ctx_t *ctx) {
+    if (!ctx) return;
+    if (ctx->dir) closedir(ctx->dir);
+    if (ctx->proc_fd != -1) close(ctx->proc_fd);
+    free(ctx->zombies);
+    free(ctx);
+}
@@ -5,6 +5,12 @@ DAEMON_PROG="./process_daemon"
 LOG_FILE="/tmp/daemon.log"
 MONITOR_TIME=30 # Tiempo en segundos para monitorear el demonio
 
+# PID del demonio más antiguo que siga vivo: un demonio anterior puede seguir como
+# zombie hasta que init lo cosecha
+live_daemon_pid() {
+    ps -eo pid,stat,comm | awk -v comm="$(basename $DAEMON_PROG)" '$3 == comm && $2 !~ /^Z/ {print $1}' | head -n 1
+}
+
 echo "--- Test 4: Long-Running Daemon Verification ---"
 
 # 1. Verificar si el programa existe
@@ -86,6 +92,226 @@ else
     kill -9 $DAEMON_PID 2>/dev/null # Intento de limpieza forzada
 fi
 
+# Las cosechas y el SIGTERM quedan en el log, y el logger vacía su anillo al apagarse
+REAPED_LINES=$(grep -c "Reaped child PID [0-9]* (worker), exit status 0." $LOG_FILE)
+if [ "$REAPED_LINES" -gt 0 ] && grep -q "Received SIGTERM" $LOG_FILE && grep -q "Goodbye" $LOG_FILE; then
+    echo "  [SUCCESS] Log: $REAPED_LINES cosechas registradas, apagado completo en el log."
+else
+    echo "  [FAILURE] Log incompleto: $REAPED_LINES cosechas registradas; faltan líneas de la cosecha o del apagado."
+    PASSED=false
+fi
+
+# 5. Modo pool: trabajadores pre-creados que reciben tareas por pipes y se reciclan
+echo ""
+echo "5. Iniciando el demonio en modo pool (--pool 4 --recycle 100)..."
+rm -f $LOG_FILE
+$DAEMON_PROG --pool 4 --recycle 100 --rate 2000
+sleep 5
+
+POOL_PID=$(live_daemon_pid)
+if [ -z "$POOL_PID" ]; then
+    echo "  [FAILURE] No se pudo encontrar el PID del demonio en modo pool."
+    PASSED=false
+else
+    POOL_ZOMBIES=$(ps -o ppid,stat -ax | awk -v pid="$POOL_PID" '$1 == pid && $2 ~ /^Z/' | wc -l)
+    # Última línea de estadísticas: "Pool: N tasks completed (...), M workers recycled."
+    POOL_LINE=$(grep "Pool: " $LOG_FILE | tail -n 1)
+    COMPLETED=$(echo "$POOL_LINE" | awk '{for (i = 1; i <= NF; i++) if ($i == "Pool:") print $(i + 1)}')
+    RECYCLED=$(echo "$POOL_LINE" | awk '{for (i = 1; i <= NF; i++) if ($i == "workers") print $(i - 1)}')
+
+    if [ "$POOL_ZOMBIES" -eq 0 ] && [ "${COMPLETED:-0}" -gt 0 ] && [ "${RECYCLED:-0}" -gt 0 ]; then
+        echo "  [SUCCESS] Pool: ${COMPLETED} tareas completadas, ${RECYCLED} trabajadores reciclados, 0 zombies."
+    else
+        echo "  [FAILURE] Pool: zombies=$POOL_ZOMBIES, completadas=${COMPLETED:-0}, recicladas=${RECYCLED:-0}."
+        PASSED=false
+    fi
+
+    # SIGUSR1 vuelca el consumo (wait4) por tipo de trabajador: los reciclados ya se cosecharon
+    kill -USR1 $POOL_PID
+    sleep 1
+    USAGE_LINE=$(grep "Usage 'pool_worker': " $LOG_FILE | tail -n 1)
+    USAGE_REAPED=$(echo "$USAGE_LINE" | awk '{for (i = 1; i <= NF; i++) if ($i == "reaped,") print $(i - 1)}')
+    if [ "${USAGE_REAPED:-0}" -gt 0 ] && echo "$USAGE_LINE" | grep -q "maxrss [1-9][0-9]* KB"; then
+        echo "  [SUCCESS] Consumo por tipo: ${USAGE_REAPED} pool_worker cosechados con rusage."
+    else
+        echo "  [FAILURE] SIGUSR1 no volcó el consumo de los trabajadores: '$USAGE_LINE'."
+        PASSED=false
+    fi
+
+    kill $POOL_PID
+    sleep 2
+    if pgrep -x "$(basename $DAEMON_PROG)" > /dev/null || pgrep -x pool_worker > /dev/null; then
+        echo "  [LIMPIEZA FALLO] Quedan procesos del pool en ejecución."
+        pkill -9 -x "$(basename $DAEMON_PROG)"
+        pkill -9 -x pool_worker
+        PASSED=false
+    else
+        echo "  [LIMPIEZA ÉXITO] El demonio y sus trabajadores terminaron."
+    fi
+fi
+
+# 6. Bucle de eventos: timerfd con intervalo por debajo del segundo, cosecha por pidfd
+echo ""
+echo "6. Iniciando el demonio con --interval-us 40000 (25 trabajadores/s)..."
+rm -f $LOG_FILE
+$DAEMON_PROG --interval-us 40000
+sleep 4
+
+FAST_PID=$(live_daemon_pid)
+if [ -z "$FAST_PID" ]; then
+    echo "  [FAILURE] No se pudo encontrar el PID del demonio."
+    PASSED=false
+else
+    # Una salida puede estar a medio cosechar en la foto: se toman hasta 3 muestras
+    FAST_ZOMBIES=1
+    for attempt in 1 2 3; do
+        FAST_ZOMBIES=$(ps -o ppid,stat -ax | awk -v pid="$FAST_PID" '$1 == pid && $2 ~ /^Z/' | wc -l)
+        [ "$FAST_ZOMBIES" -eq 0 ] && break
+        sleep 0.2
+    done
+    kill $FAST_PID
+    sleep 2
+    SPAWNED=$(grep -c "Spawned new worker" $LOG_FILE)
+    REAPED=$(grep -c "Reaped child PID [0-9]* (worker)" $LOG_FILE)
+
+    # En 4 s a 25/s: con granularidad de segundos no pasarían de 5 lanzamientos
+    if [ "$FAST_ZOMBIES" -eq 0 ] && [ "$SPAWNED" -ge 80 ] && [ "$REAPED" -ge 30 ]; then
+        echo "  [SUCCESS] $SPAWNED trabajadores lanzados por timerfd, $REAPED cosechados por pidfd, 0 zombies."
+    else
+        echo "  [FAILURE] zombies=$FAST_ZOMBIES, lanzados=$SPAWNED, cosechados=$REAPED."
+        PASSED=false
+    fi
+    if [ -n "$(live_daemon_pid)" ]; then
+        echo "  [LIMPIEZA FALLO] El demonio no atendió SIGTERM por signalfd."
+        pkill -9 -x "$(basename $DAEMON_PROG)"
+        PASSED=false
+    fi
+fi
+
+# 7. Cola de trabajos por socket UNIX: admisión acotada por MAX_WORKERS y contrapresión
+echo ""
+echo "7. Enviando 600 trabajos de 20 ms al demonio (--submit, límite de 100 trabajadores)..."
+rm -f $LOG_FILE
+$DAEMON_PROG
+sleep 1
+JOB_PID=$(live_daemon_pid)
+SUBMIT_OUT=$($DAEMON_PROG --submit 600 --work-us 20000)
+SUBMIT_RC=$?
+echo "  - $SUBMIT_OUT"
+# "Submitted 600 jobs: N completed (...) ...; peak P workers (limit L); ..."
+JOBS_DONE=$(echo "$SUBMIT_OUT" | awk '{for (i = 1; i <= NF; i++) if ($i == "completed") print $(i - 1)}')
+JOBS_PEAK=$(echo "$SUBMIT_OUT" | awk '{for (i = 1; i <= NF; i++) if ($i == "peak") print $(i + 1)}')
+JOB_ZOMBIES=$(ps -o ppid,stat -ax | awk -v pid="$JOB_PID" '$1 == pid && $2 ~ /^Z/' | wc -l)
+
+if [ "$SUBMIT_RC" -eq 0 ] && [ "${JOBS_DONE:-0}" -eq 600 ] && [ "${JOBS_PEAK:-999}" -le 100 ] && [ "$JOB_ZOMBIES" -eq 0 ]; then
+    echo "  [SUCCESS] 600 trabajos completados con como máximo ${JOBS_PEAK} trabajadores a la vez, 0 zombies."
+else
+    echo "  [FAILURE] rc=$SUBMIT_RC, completados=${JOBS_DONE:-0}, pico=${JOBS_PEAK:-?}, zombies=$JOB_ZOMBIES."
+    PASSED=false
+fi
+kill $JOB_PID
+sleep 2
+if grep -q "Job queue full: pausing submitters." $LOG_FILE && [ ! -S /tmp/process_daemon.sock ]; then
+    echo "  [SUCCESS] La cola llena aplicó contrapresión y el socket se eliminó al apagarse."
+else
+    echo "  [FAILURE] Sin contrapresión registrada o el socket sigue existiendo."
+    PASSED=false
+fi
+
+# 8. Métricas en vivo: se consultan cada 50 ms mientras el demonio atiende trabajos
+echo ""
+echo "8. Consultando métricas (--metrics) durante el envío de 300 trabajos..."
+rm -f $LOG_FILE
+$DAEMON_PROG
+sleep 1
+METRICS_PID=$(live_daemon_pid)
+(for i in $(seq 40); do $DAEMON_PROG --metrics prometheus > /dev/null; sleep 0.05; done) &
+SCRAPER=$!
+$DAEMON_PROG --submit 300 --work-us 10000 > /dev/null
+SUBMIT_RC=$?
+wait $SCRAPER
+METRICS_JSON=$($DAEMON_PROG --metrics json)
+PROM=$($DAEMON_PROG --metrics prometheus)
+SPAWNED_TOTAL=$(echo "$PROM" | awk '$1 == "process_daemon_workers_spawned_total" {print $2}')
+REAPED_TOTAL=$(echo "$PROM" | awk '$1 == "process_daemon_workers_reaped_total" {print $2}')
+EXITS_OK=$(echo "$PROM" | awk '$1 == "process_daemon_worker_exits_total{status=\"0\"}" {print $2}')
+LATENCY_COUNT=$(echo "$PROM" | awk '$1 == "process_daemon_spawn_latency_seconds_count" {print $2}')
+
+if [ "$SUBMIT_RC" -eq 0 ] && [ "${SPAWNED_TOTAL:-0}" -ge 300 ] && [ "$REAPED_TOTAL" = "$EXITS_OK" ] && \
+   [ "$LATENCY_COUNT" = "$SPAWNED_TOTAL" ] && echo "$METRICS_JSON" | grep -q '"jobs_submitted":300'; then
+    echo "  [SUCCESS] Métricas: $SPAWNED_TOTAL lanzados, $REAPED_TOTAL cosechados (estado 0), 300 trabajos recibidos."
+else
+    echo "  [FAILURE] rc=$SUBMIT_RC, lanzados=${SPAWNED_TOTAL:-?}, cosechados=${REAPED_TOTAL:-?}, estado 0=${EXITS_OK:-?}, JSON: $METRICS_JSON"
+    PASSED=false
+fi
+kill $METRICS_PID
+sleep 2
+if [ -S /tmp/process_daemon.metrics ]; then
+    echo "  [FAILURE] El socket de métricas sigue existiendo tras el apagado."
+    PASSED=false
+fi
+
+# 9. Contención con cgroup v2: SIGTERM con 50 trabajos en curso se resuelve con cgroup.kill
+echo ""
+echo "9. Apagando el demonio (--cgroup) con 50 trabajos de 10 s en curso..."
+CG_ROOT=$(awk '$0 ~ / - cgroup2 / {print $5; exit}' /proc/self/mountinfo)
+if [ -z "$CG_ROOT" ] || [ ! -w "$CG_ROOT" ]; then
+    echo "  [OMITIDO] No hay jerarquía cgroup v2 escribible."
+else
+    rm -f $LOG_FILE
+    $DAEMON_PROG --cgroup
+    sleep 1
+    CG_PID=$(live_daemon_pid)
+    $DAEMON_PROG --submit 50 --work-us 10000000 > /tmp/daemon_submit.out &
+    SUBMITTER=$!
+    sleep 1
+    CG_DIR=$(sed -n "s|.*workers contained in \([^ ]*\) .*|\1|p" $LOG_FILE)
+    CONTAINED=$(cat "$CG_DIR/job_worker/cgroup.procs" 2>/dev/null | wc -l)
+    kill $CG_PID
+    wait $SUBMITTER
+    sleep 1
+    LEFT=$(ps -eo comm | grep -c "^job_worker$")
+
+    if [ "$CONTAINED" -eq 50 ] && grep -q "killed [0-9]* in-flight workers with one cgroup.kill write" $LOG_FILE && \
+       grep -q "0 left unreaped" $LOG_FILE && [ "$LEFT" -eq 0 ] && [ ! -d "$CG_DIR" ] && \
+       grep -q "50 completed (50 failed)" /tmp/daemon_submit.out; then
+        echo "  [SUCCESS] 50 trabajadores contenidos en $CG_DIR, eliminados con una escritura en cgroup.kill y cosechados."
+    else
+        echo "  [FAILURE] contenidos=$CONTAINED, restantes=$LEFT, subárbol='$CG_DIR'."
+        grep -E "cgroup|Shutdown" $LOG_FILE
+        PASSED=false
+    fi
+    rm -f /tmp/daemon_submit.out
+fi
+
+# 10. Modo multi-shard: 4 supervisores reparten MAX_WORKERS y se roban trabajos
+echo ""
+echo "10. Enviando 4 x 200 trabajos a un demonio con --shards 4..."
+rm -f $LOG_FILE
+$DAEMON_PROG --shards 4
+sleep 1
+SHARD_PID=$(live_daemon_pid)
+for i in 1 2 3 4; do
+    $DAEMON_PROG --submit 200 --work-us 5000 > /tmp/daemon_submit.$i.out &
+done
+wait
+SHARD_DONE=$(cat /tmp/daemon_submit.*.out | awk '{for (i = 1; i <= NF; i++) if ($i == "completed") s += $(i - 1)} END {print s + 0}')
+SHARD_PEAK=$(cat /tmp/daemon_submit.*.out | awk '{for (i = 1; i <= NF; i++) if ($i == "peak" && $(i + 1) > p) p = $(i + 1)} END {print p + 0}')
+SHARD_ZOMBIES=$(ps -o ppid,stat -ax | awk -v pid="$SHARD_PID" '$1 == pid && $2 ~ /^Z/' | wc -l)
+SHARD_THREADS=$(grep -c "Shard [0-3] pinned to CPU" $LOG_FILE)
+rm -f /tmp/daemon_submit.*.out
+kill $SHARD_PID
+sleep 2
+
+if [ "$SHARD_DONE" -eq 800 ] && [ "$SHARD_PEAK" -le 100 ] && [ "$SHARD_ZOMBIES" -eq 0 ] && [ "$SHARD_THREADS" -eq 4 ] && \
+   grep -q "Scheduler stopped: .* jobs stolen." $LOG_FILE && [ ! -S /tmp/process_daemon.sock ]; then
+    echo "  [SUCCESS] 800 trabajos completados por 4 shards fijados a CPU, pico ${SHARD_PEAK} trabajadores, 0 zombies."
+else
+    echo "  [FAILURE] completados=$SHARD_DONE, pico=$SHARD_PEAK, zombies=$SHARD_ZOMBIES, shards=$SHARD_THREADS."
+    grep -E "Shard|Scheduler" $LOG_FILE
+    PASSED=false
+fi
+
 echo "--- Test 4: Finalizado ---"
 
 if [ "$PASSED" = true ]; then
@@ -16,8 +16,9 @@ fi
 echo "1. Creando $NUM_ZOMBIES procesos zombie en segundo plano..."
 
 # Ejecutar zombie_creator en segundo plano.
-# Redirigimos stdin para evitar que espere la tecla ENTER del script.
-$CREATOR_PROG $NUM_ZOMBIES < /dev/null & 
+# stdin queda abierto (sin datos) para que espere ENTER sin consumir la terminal;
+# con /dev/null, getchar() devuelve EOF de inmediato y el creador termina antes del escaneo.
+$CREATOR_PROG $NUM_ZOMBIES < <(sleep 30) & 
 CREATOR_PID=$!
 
 if [ -z "$CREATOR_PID" ]; then
@@ -64,6 +65,31 @@ else
     echo "  [FALLO] El análisis de padres no pudo verificar al creador PID $CREATOR_PID con $NUM_ZOMBIES zombies."
 fi
 
+# Comprobación 3: el escaneo paralelo (-j) debe reportar lo mismo que el secuencial
+PARALLEL_OUTPUT=$($DETECTOR_PROG -j 4)
+PARALLEL_ZOMBIES=$(echo "$PARALLEL_OUTPUT" | grep 'Total Zombies:' | awk '{print $3}')
+if [ "$PARALLEL_ZOMBIES" = "$REPORTED_ZOMBIES" ] && \
+   echo "$PARALLEL_OUTPUT" | grep -q "PID $CREATOR_PID.*has $NUM_ZOMBIES zombie children"; then
+    echo "  [ÉXITO] El escaneo paralelo (-j 4) coincide con el secuencial ($PARALLEL_ZOMBIES zombies)."
+else
+    echo "  [FALLO] El escaneo paralelo (-j 4) reporta $PARALLEL_ZOMBIES zombies (secuencial: $REPORTED_ZOMBIES)."
+fi
+
+# Comprobación 3b: la cadena de ancestros termina en el creador con sus zombies en el subárbol
+if echo "$DETECTOR_OUTPUT" | grep -A20 'Zombie Ancestry' | grep -q "(1)\[[0-9]*\] -> .*zombie_creator($CREATOR_PID)\[$NUM_ZOMBIES\]\$"; then
+    echo "  [ÉXITO] La cadena de ancestros va desde PID 1 hasta el creador PID $CREATOR_PID con [$NUM_ZOMBIES] zombies."
+else
+    echo "  [FALLO] La sección 'Zombie Ancestry' no atribuye los zombies al creador PID $CREATOR_PID."
+fi
+
+# Comprobación 4: salida para máquinas (una línea JSON por zombie; CSV con cabecera y 2 fotos)
+JSONL_COUNT=$($DETECTOR_PROG --format=jsonl | grep -c "\"ppid\":$CREATOR_PID,")
+CSV_COUNT=$($DETECTOR_PROG --format=csv --interval=0.2 --count=2 | grep -c "^[0-9]*,[0-9]*,$CREATOR_PID,")
+if [ "$JSONL_COUNT" -eq "$NUM_ZOMBIES" ] && [ "$CSV_COUNT" -eq $((2 * NUM_ZOMBIES)) ]; then
+    echo "  [ÉXITO] --format=jsonl/csv emiten $NUM_ZOMBIES registros por foto del PID $CREATOR_PID."
+else
+    echo "  [FALLO] --format: jsonl=$JSONL_COUNT, csv (2 fotos)=$CSV_COUNT registros (se esperaban $NUM_ZOMBIES y $((2 * NUM_ZOMBIES)))."
+fi
 
 # 4. Limpieza: Matar al proceso padre (zombie_creator)
 echo "4. Limpiando: Enviando SIGTERM al Proceso Padre PID $CREATOR_PID..."
@@ -79,4 +105,72 @@ else
     echo "  [ADVERTENCIA] No se pudieron limpiar todos los zombies."
 fi
 
+# 5. Capacidad: más zombies que el antiguo límite fijo (1024) y padres ordenados por conteo
+LARGE_ZOMBIES=1500
+echo "5. Creando $LARGE_ZOMBIES zombies (por encima del antiguo límite de 1024) y 2 de otro padre..."
+$CREATOR_PROG $LARGE_ZOMBIES < <(sleep 30) > /dev/null &
+LARGE_PID=$!
+$CREATOR_PROG 2 < <(sleep 30) > /dev/null &
+SMALL_PID=$!
+sleep 3
+
+LARGE_OUTPUT=$($DETECTOR_PROG)
+LARGE_REPORTED=$(echo "$LARGE_OUTPUT" | grep 'Total Zombies:' | awk '{print $3}')
+FIRST_PARENT=$(echo "$LARGE_OUTPUT" | grep -A1 'Parent Process Analysis:' | tail -n 1)
+
+if [ "$LARGE_REPORTED" -ge $((LARGE_ZOMBIES + 2)) ] && echo "$FIRST_PARENT" | grep -q "PID $LARGE_PID .*has $LARGE_ZOMBIES zombie children"; then
+    echo "  [ÉXITO] $LARGE_REPORTED zombies reportados sin truncar; el padre con más zombies aparece primero."
+else
+    echo "  [FALLO] Reporte truncado o mal ordenado: $LARGE_REPORTED zombies; primer padre: '$FIRST_PARENT'."
+fi
+
+kill $LARGE_PID $SMALL_PID
+
+# 6. Modo --watch: los zombies nuevos se reportan por eventos del kernel, sin re-escanear /proc
+WATCH_ZOMBIES=4
+WATCH_OUT=$(mktemp)
+echo "6. Iniciando $DETECTOR_PROG --watch y creando $WATCH_ZOMBIES zombies..."
+$DETECTOR_PROG --watch > "$WATCH_OUT" 2>&1 &
+WATCH_PID=$!
+sleep 1
+
+if ! kill -0 $WATCH_PID 2>/dev/null; then
+    # El proc connector requiere CAP_NET_ADMIN (normalmente root)
+    echo "  [OMITIDO] --watch no pudo suscribirse al proc connector: $(tail -n 1 "$WATCH_OUT")"
+else
+    $CREATOR_PROG $WATCH_ZOMBIES < <(sleep 30) > /dev/null &
+    WATCH_CREATOR=$!
+    sleep 1
+    WATCH_FOUND=$(grep -c "^+zombie PID .* PPID $WATCH_CREATOR " "$WATCH_OUT")
+
+    if [ "$WATCH_FOUND" -eq "$WATCH_ZOMBIES" ]; then
+        echo "  [ÉXITO] --watch reportó los $WATCH_ZOMBIES zombies nuevos del PID $WATCH_CREATOR."
+    else
+        echo "  [FALLO] --watch reportó $WATCH_FOUND de $WATCH_ZOMBIES zombies nuevos."
+    fi
+    kill $WATCH_CREATOR $WATCH_PID
+fi
+rm -f "$WATCH_OUT"
+
+# 7. Modo --track: un padre que acumula zombies dispara la alerta de tasa de fuga
+TRACK_ZOMBIES=30
+TRACK_OUT=$(mktemp)
+echo "7. Iniciando $DETECTOR_PROG --track y creando $TRACK_ZOMBIES zombies de golpe..."
+$DETECTOR_PROG --track --interval=0.2 --count=15 --alert-rate=5 > "$TRACK_OUT" &
+TRACK_PID=$!
+sleep 0.5
+$CREATOR_PROG $TRACK_ZOMBIES < <(sleep 30) > /dev/null &
+TRACK_CREATOR=$!
+wait $TRACK_PID
+
+if grep -q "^ALERT: PPID $TRACK_CREATOR (zombie_creator)" "$TRACK_OUT" && \
+   grep -q "^PPID $TRACK_CREATOR (zombie_creator): $TRACK_ZOMBIES zombies, .* $TRACK_ZOMBIES new total" "$TRACK_OUT"; then
+    echo "  [ÉXITO] --track alertó sobre el PID $TRACK_CREATOR y contó sus $TRACK_ZOMBIES zombies nuevos."
+else
+    echo "  [FALLO] --track no alertó sobre el PID $TRACK_CREATOR:"
+    cat "$TRACK_OUT"
+fi
+kill $TRACK_CREATOR
+rm -f "$TRACK_OUT"
+
 echo "--- Test 2: Finalizado ---"
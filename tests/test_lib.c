@@ -3,24 +3,375 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <fcntl.h>
 
 // Nota: Usa la ruta relativa correcta para el header
 #include "../src/zombie.h" 
+#include "../src/zombie_internal.h" // Constantes del registro para el modo registry
 
 #define NUM_PROCESSES 5
+#define REAP_TIMEOUT 3 // Segundos máximos de espera para la cosecha automática
 
-int main() {
+#define COLLIDING_MAX (4 * REGISTRY_PROBES)
+
+// Resultados recogidos por el callback del modo polled
+static int polled_reaped = 0;
+static int polled_status_sum = 0;
+
+static void on_child_exit(pid_t pid, int status, const struct rusage *usage, void *arg) {
+    (void) pid;
+    (void) usage;
+    int *count = arg;
+    (*count)++;
+    polled_reaped++;
+    if (status != -1 && WIFEXITED(status)) polled_status_sum += WEXITSTATUS(status);
+}
+
+/**
+ * @brief Modo "scan": el escáner de la librería encuentra zombies creados aquí
+ * y reutiliza su arena entre escaneos.
+ */
+static int run_scan_test(void) {
+    pid_t zombies[NUM_PROCESSES];
+    zombie_scan_result_t first, second;
+
+    printf("--- Test del escáner de /proc (zombie_scan_ctx_t) ---\n");
+    fflush(stdout);
+    for (int i = 0; i < NUM_PROCESSES; i++) {
+        zombies[i] = fork();
+        if (zombies[i] == 0) _exit(0); // Sin wait(): queda como zombie de este proceso
+    }
+    struct timespec settle = {0, 200000000};
+    nanosleep(&settle, NULL);
+
+    zombie_scan_ctx_t *ctx = zombie_scan_create();
+    if (!ctx || zombie_scan(ctx, &first) != 0 || zombie_scan(ctx, &second) != 0) {
+        perror("zombie_scan");
+        return 1;
+    }
+
+    int mine = 0;
+    for (size_t i = 0; i < second.count; i++) {
+        if (second.zombies[i].ppid == getpid() && second.zombies[i].start_time > 0) mine++;
+    }
+    printf("Procesos examinados: %zu, zombies: %zu (propios: %d)\n", second.processes, second.count, mine);
+
+    // El segundo escaneo reutiliza el mismo arena: ninguna reserva tras el calentamiento
+    int ok = mine == NUM_PROCESSES && first.count == second.count && first.zombies == second.zombies;
+    zombie_scan_destroy(ctx);
+    for (int i = 0; i < NUM_PROCESSES; i++) waitpid(zombies[i], NULL, 0);
+
+    if (!ok) {
+        printf("\n[FALLO] El escáner no encontró los %d zombies propios o no reutilizó su arena.\n", NUM_PROCESSES);
+        return 1;
+    }
+    printf("\n[ÉXITO] El escáner encontró los %d zombies propios y reutilizó su arena.\n", NUM_PROCESSES);
+    return 0;
+}
+
+/**
+ * @brief Lanza `sh` con `method`, stdout redirigido a un pipe (DUP2), stderr a
+ * /dev/null (OPEN) y un entorno propio, y comprueba su salida y su código de salida.
+ * @return 0 si todo coincide, 1 si no.
+ */
+static int check_spawn_method(zombie_spawn_method_t method, const char *name) {
+    int pipe_fds[2];
+    char buf[64] = {0};
+    char env_var[48];
+    char expected[64];
+    snprintf(env_var, sizeof(env_var), "ZOMBIE_TEST=%s", name);
+    snprintf(expected, sizeof(expected), "%s:unset\n", name);
+
+    if (pipe(pipe_fds) == -1) {
+        perror("pipe");
+        return 1;
+    }
+    char *sh_argv[] = {"sh", "-c", "echo \"$ZOMBIE_TEST:${HOME-unset}\"; echo ruido >&2; exit 5", NULL};
+    char *envp[] = {env_var, NULL}; // Sin HOME: el hijo no hereda el entorno del padre
+    zombie_file_action_t actions[] = {
+        {ZOMBIE_FA_DUP2, STDOUT_FILENO, pipe_fds[1], NULL, 0, 0},
+        {ZOMBIE_FA_OPEN, STDERR_FILENO, -1, "/dev/null", O_WRONLY, 0},
+    };
+    zombie_spawn_opts_t opts = {method, envp, actions, 2};
+
+    pid_t pid = zombie_spawn_ex("/bin/sh", sh_argv, &opts);
+    close(pipe_fds[1]);
+    if (pid == -1) {
+        perror("zombie_spawn_ex");
+        close(pipe_fds[0]);
+        return 1;
+    }
+    ssize_t n, got = 0;
+    while ((n = read(pipe_fds[0], buf + got, sizeof(buf) - 1 - (size_t) got)) > 0) got += n;
+    close(pipe_fds[0]);
+
+    zombie_child_status_t child;
+    if (strcmp(buf, expected) != 0) {
+        printf("\n[FALLO] %s: el hijo escribió \"%s\", se esperaba \"%s\".\n", name, buf, expected);
+        return 1;
+    }
+    if (zombie_wait_child(pid, REAP_TIMEOUT * 1000, &child) != 0 || !child.exited || child.exit_status != 5) {
+        printf("\n[FALLO] %s: no se recuperó exit(5) del PID %d.\n", name, pid);
+        return 1;
+    }
+    printf("%s: acciones DUP2/OPEN y envp aplicados, exit(5) recuperado (ok)\n", name);
+    return 0;
+}
+
+/**
+ * @brief Modo "spawn": zombie_spawn_ex con ZOMBIE_SPAWN_POSIX y ZOMBIE_SPAWN_FORK, con
+ * acciones sobre descriptores y entorno propio, y el fallo de exec de cada método.
+ */
+static int run_spawn_test(void) {
+    char *missing_argv[] = {"no_existe", NULL};
+    zombie_child_status_t child;
+
+    printf("--- Test de zombie_spawn_ex (POSIX y FORK) ---\n");
+    zombie_init();
+    if (check_spawn_method(ZOMBIE_SPAWN_POSIX, "posix") != 0 || check_spawn_method(ZOMBIE_SPAWN_FORK, "fork") != 0) {
+        return 1;
+    }
+
+    // POSIX: el fallo de exec vuelve al padre como error
+    zombie_spawn_opts_t posix_opts = {ZOMBIE_SPAWN_POSIX, NULL, NULL, 0};
+    errno = 0;
+    if (zombie_spawn_ex("/no/existe", missing_argv, &posix_opts) != -1 || errno != ENOENT) {
+        printf("\n[FALLO] ZOMBIE_SPAWN_POSIX no devolvió -1/ENOENT para un ejecutable inexistente.\n");
+        return 1;
+    }
+    // FORK: el exec falla en el hijo, que termina con 127
+    zombie_file_action_t quiet = {ZOMBIE_FA_OPEN, STDERR_FILENO, -1, "/dev/null", O_WRONLY, 0};
+    zombie_spawn_opts_t fork_opts = {ZOMBIE_SPAWN_FORK, NULL, &quiet, 1};
+    fflush(stdout);
+    pid_t pid = zombie_spawn_ex("/no/existe", missing_argv, &fork_opts);
+    if (pid == -1 || zombie_wait_child(pid, REAP_TIMEOUT * 1000, &child) != 0 || child.exit_status != 127) {
+        printf("\n[FALLO] ZOMBIE_SPAWN_FORK no reportó exit(127) para un ejecutable inexistente.\n");
+        return 1;
+    }
+    printf("Fallo de exec: POSIX devuelve -1/ENOENT, FORK termina con exit(127) (ok)\n");
+
+    zombie_stats_t stats;
+    zombie_get_stats(&stats);
+    if (stats.zombies_created != 3 || stats.zombies_reaped != 3) {
+        printf("\n[FALLO] Estadísticas incorrectas: %lld creados, %lld cosechados (se esperaban 3).\n",
+               stats.zombies_created, stats.zombies_reaped);
+        return 1;
+    }
+    printf("\n[ÉXITO] zombie_spawn_ex aplicó acciones y entorno con POSIX y FORK y reportó los fallos de exec.\n");
+    return 0;
+}
+
+/**
+ * @brief Crea un hijo con zombie_safe_fork intentando que reciba el PID `target`
+ * (vía /proc/sys/kernel/ns_last_pid). El hijo espera a que el padre cierre el pipe
+ * `gate` (si gate[0] no es -1) y termina con `code`.
+ * @return PID del hijo (puede diferir de `target`), o -1 en error.
+ */
+static pid_t fork_at(pid_t target, const int gate[2], int code) {
+    int fd = open("/proc/sys/kernel/ns_last_pid", O_WRONLY | O_CLOEXEC);
+    if (fd != -1) {
+        char buf[16];
+        int len = snprintf(buf, sizeof(buf), "%d", (int) target - 1);
+        if (write(fd, buf, (size_t) len) != len) {} // Sin permiso: PID cualquiera
+        close(fd);
+    }
+    pid_t pid = zombie_safe_fork();
+    if (pid == 0) {
+        char c;
+        if (gate[0] != -1) {
+            close(gate[1]);
+            while (read(gate[0], &c, 1) == -1 && errno == EINTR) {}
+        }
+        _exit(code);
+    }
+    return pid;
+}
+
+/**
+ * @brief Crea una ronda de hijos en los PIDs `targets` y comprueba que
+ * zombie_wait_child devuelve el código de salida de cada hijo registrado.
+ * @param hold Si es distinto de 0, todos siguen vivos hasta crear el último.
+ * @return Hijos que recibieron su PID objetivo, o -1 si la ronda falló.
+ */
+static int run_colliding_round(const pid_t *targets, int n, int hold, int code_base) {
+    pid_t pids[COLLIDING_MAX];
+    int gate[2] = {-1, -1};
+    int placed = 0;
+
+    if (hold && pipe(gate) == -1) {
+        perror("pipe");
+        return -1;
+    }
+    fflush(stdout);
+    for (int i = 0; i < n; i++) {
+        pids[i] = fork_at(targets[i], gate, code_base + i);
+        if (pids[i] == -1) {
+            perror("zombie_safe_fork");
+            return -1;
+        }
+        if (pids[i] == targets[i]) placed++;
+    }
+    if (hold) {
+        close(gate[0]);
+        close(gate[1]);
+    }
+
+    for (int i = 0; i < n; i++) {
+        zombie_child_status_t child;
+        if (zombie_wait_child(pids[i], REAP_TIMEOUT * 1000, &child) != 0) {
+            if (errno == ESRCH) continue; // No cupo en su ventana: sin estado
+            printf("\n[FALLO] zombie_wait_child(%d) no vio la cosecha (errno %d).\n", pids[i], errno);
+            return -1;
+        }
+        if (!child.exited || child.exit_status != code_base + i) {
+            printf("\n[FALLO] PID %d: se esperaba exit(%d), el registro indica %d.\n",
+                   pids[i], code_base + i, child.exit_status);
+            return -1;
+        }
+    }
+    return placed;
+}
+
+/**
+ * @brief Modo "registry": llena más de REGISTRY_PROBES ranuras que colisionan en el
+ * registro de hijos y verifica que registro y cosecha coinciden en la misma ranura,
+ * también cuando hay que desalojar salidas antiguas.
+ */
+static int run_registry_test(void) {
+    pid_t targets[COLLIDING_MAX];
+    int n = 0;
+
+    printf("--- Test del registro con ventanas de sondeo llenas ---\n");
+    if (access("/proc/sys/kernel/ns_last_pid", W_OK) != 0) {
+        printf("[OMITIDO] Sin permiso sobre ns_last_pid: no se pueden elegir PIDs que colisionen.\n");
+        return 0;
+    }
+    if (zombie_init_backend(ZOMBIE_BACKEND_PIDFD) == -1) {
+        perror("zombie_init_backend(PIDFD)");
+        return 1;
+    }
+
+    int pid_max = 32768;
+    FILE *fp = fopen("/proc/sys/kernel/pid_max", "r");
+    if (fp) {
+        if (fscanf(fp, "%d", &pid_max) != 1) pid_max = 32768;
+        fclose(fp);
+    }
+
+    // PIDs libres cuyas ventanas se solapan con [base, base + REGISTRY_PROBES), agrupados
+    // por desplazamiento con el mismo hash que usa zombie.c. Los de hash `base` van al
+    // final: para entonces su ventana ya está llena.
+    enum { PER_OFFSET = 4 };
+    static pid_t by_offset[2 * REGISTRY_PROBES][PER_OFFSET];
+    int counts[2 * REGISTRY_PROBES] = {0};
+    unsigned int base = ((unsigned int) getpid() * 7919u) & (REGISTRY_SLOTS - 1);
+    for (pid_t pid = 1001; pid < pid_max; pid++) {
+        int d = (int)((zombie_registry_hash(pid) - base + REGISTRY_PROBES) & (REGISTRY_SLOTS - 1));
+        if (d == 0 || d >= 2 * REGISTRY_PROBES || counts[d] == PER_OFFSET) continue;
+        if (kill(pid, 0) == -1 && errno == ESRCH) by_offset[d][counts[d]++] = pid;
+    }
+    for (int d = 1; d <= 2 * REGISTRY_PROBES; d++) {
+        if (d == REGISTRY_PROBES) continue;
+        int slot = d == 2 * REGISTRY_PROBES ? REGISTRY_PROBES : d; // El hash `base` se visita el último
+        for (int i = 0; i < counts[slot] && n < COLLIDING_MAX; i++) targets[n++] = by_offset[slot][i];
+    }
+    printf("%d PIDs objetivo con ventanas que colisionan (%d ranuras por ventana)\n", n, REGISTRY_PROBES);
+
+    // Ronda 1: todos vivos a la vez; los que no caben quedan sin registrar
+    int placed = run_colliding_round(targets, n, 1, 1);
+    if (placed < 0) return 1;
+    if (placed <= REGISTRY_PROBES) {
+        printf("[OMITIDO] Solo %d hijos recibieron su PID objetivo (hacen falta más de %d).\n",
+               placed, REGISTRY_PROBES);
+        return 0;
+    }
+    // Ronda 2: los mismos PIDs, salidas inmediatas que compiten con el registro y desalojan
+    if (run_colliding_round(targets, n, 0, 101) < 0) return 1;
+
+    zombie_stats_t stats;
+    zombie_stats_ex_t ex;
+    zombie_get_stats(&stats);
+    zombie_get_stats_ex(&ex);
+    printf("Hijos: %lld creados, %lld cosechados, %lld sin registrar\n",
+           stats.zombies_created, stats.zombies_reaped, ex.untracked_children);
+    if (ex.untracked_children == 0) {
+        printf("\n[FALLO] %d hijos vivos en %d ranuras no desbordaron ninguna ventana.\n", placed, REGISTRY_PROBES);
+        return 1;
+    }
+    printf("\n[ÉXITO] Con %d hijos en ventanas llenas, cada hijo registrado reportó su código de salida.\n", placed);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
     zombie_stats_t current_stats;
+    pid_t child_pids[NUM_PROCESSES];
     int i;
+    const char *mode = argc > 1 ? argv[1] : "signal";
+    int use_pidfd = (strcmp(mode, "pidfd") == 0);
+    int use_server = (strcmp(mode, "server") == 0);
+    int use_polled = (strcmp(mode, "polled") == 0);
+    pid_t foreign_pid = -1;
+
+    if (strcmp(mode, "scan") == 0) {
+        return run_scan_test();
+    }
+    if (strcmp(mode, "registry") == 0) {
+        return run_registry_test();
+    }
+    if (strcmp(mode, "spawn") == 0) {
+        return run_spawn_test();
+    }
     
-    printf("--- Test de la Librería Zombie Prevention ---\n");
+    printf("--- Test de la Librería Zombie Prevention (%s) ---\n", mode);
     
     // 1. Inicializar el handler de cosecha (vital para la librería)
-    zombie_init();
+    if (use_pidfd) {
+        if (zombie_init_backend(ZOMBIE_BACKEND_PIDFD) == -1) {
+            perror("zombie_init_backend(PIDFD)");
+            return 1;
+        }
+
+        // Un hijo creado fuera de la librería: el backend pidfd no debe cosecharlo
+        fflush(stdout);
+        foreign_pid = fork();
+        if (foreign_pid == 0) {
+            exit(42);
+        }
+    } else if (use_server) {
+        if (zombie_init_spawn_server(ZOMBIE_BACKEND_SIGNAL) == -1) {
+            perror("zombie_init_spawn_server");
+            return 1;
+        }
+    } else if (use_polled) {
+        if (zombie_init_backend(ZOMBIE_BACKEND_POLLED) == -1) {
+            perror("zombie_init_backend(POLLED)");
+            return 1;
+        }
+        // El modo polled no debe instalar un handler de SIGCHLD a espaldas del llamador
+        struct sigaction current;
+        sigaction(SIGCHLD, NULL, &current);
+        if (current.sa_handler != SIG_DFL) {
+            printf("\n[FALLO] ZOMBIE_BACKEND_POLLED instaló un handler de SIGCHLD.\n");
+            return 1;
+        }
+    } else if (strcmp(mode, "threaded") == 0) {
+        if (zombie_init_threaded() == -1) {
+            perror("zombie_init_threaded");
+            return 1;
+        }
+    } else {
+        zombie_init();
+    }
     printf("Zombie handler inicializado. Los procesos hijos serán cosechados automáticamente.\n");
 
     // 2. Crear procesos usando zombie_safe_fork
     printf("\nCreando %d hijos usando zombie_safe_fork...\n", NUM_PROCESSES);
+    fflush(stdout); // Evita que los hijos repitan la salida pendiente del buffer
     for (i = 0; i < NUM_PROCESSES; i++) {
         pid_t pid = zombie_safe_fork();
         
@@ -34,24 +385,139 @@ int main() {
             sleep(1); // Simula trabajo
             exit(i + 1); // El hijo termina y se convierte en zombie (temporalmente)
         }
+        child_pids[i] = pid;
+    }
+
+    // El registro debe conocer a cada hijo mientras sigue corriendo
+    zombie_child_status_t child;
+    if (zombie_get_child_status(child_pids[0], &child) != 0 || child.state != ZOMBIE_CHILD_RUNNING) {
+        printf("\n[FALLO] El registro no contiene al hijo PID %d en ejecución.\n", child_pids[0]);
+        return 1;
+    }
+
+    if (use_polled) {
+        // Bucle de eventos del llamador: poll() sobre el fd de la librería
+        struct pollfd pfd = {zombie_get_fd(), POLLIN, 0};
+        int calls = 0;
+        while (polled_reaped < NUM_PROCESSES) {
+            if (poll(&pfd, 1, REAP_TIMEOUT * 1000) <= 0) {
+                printf("\n[FALLO] El fd de zombie_get_fd() no se volvió legible.\n");
+                return 1;
+            }
+            if (zombie_process_events(on_child_exit, &calls) == -1) {
+                perror("zombie_process_events");
+                return 1;
+            }
+        }
+        if (polled_status_sum != NUM_PROCESSES * (NUM_PROCESSES + 1) / 2 || calls != NUM_PROCESSES) {
+            printf("\n[FALLO] El callback recibió estados incorrectos (suma %d).\n", polled_status_sum);
+            return 1;
+        }
+        printf("zombie_process_events entregó %d salidas por callback (ok)\n", calls);
+    }
+
+    // zombie_wait_child recupera el código de salida que el backend descartaba antes
+    for (i = 0; i < NUM_PROCESSES; i++) {
+        if (zombie_wait_child(child_pids[i], REAP_TIMEOUT * 1000, &child) != 0) {
+            perror("zombie_wait_child");
+            return 1;
+        }
+        if (!child.exited || child.exit_status != i + 1) {
+            printf("\n[FALLO] PID %d: se esperaba exit(%d), el registro indica %d.\n",
+                   child_pids[i], i + 1, child.exit_status);
+            return 1;
+        }
+    }
+    printf("Códigos de salida recuperados con zombie_wait_child: 1..%d (ok)\n", NUM_PROCESSES);
+
+    if (use_server) {
+        // El servidor recibe el extremo de escritura del pipe por SCM_RIGHTS (ZOMBIE_FA_DUP2)
+        int pipe_fds[2];
+        char buf[16] = {0};
+        char *sh_argv[] = {"sh", "-c", "echo zygote; sleep 1; exit 7", NULL};
+        if (pipe(pipe_fds) == -1) {
+            perror("pipe");
+            return 1;
+        }
+        zombie_file_action_t redirect = {ZOMBIE_FA_DUP2, STDOUT_FILENO, pipe_fds[1], NULL, 0, 0};
+        zombie_spawn_opts_t opts = {ZOMBIE_SPAWN_SERVER, NULL, &redirect, 1};
+
+        pid_t pid = zombie_spawn_ex("/bin/sh", sh_argv, &opts);
+        close(pipe_fds[1]);
+        if (pid == -1) {
+            perror("zombie_spawn_ex(SERVER)");
+            return 1;
+        }
+        if (read(pipe_fds[0], buf, sizeof(buf) - 1) <= 0 || strcmp(buf, "zygote\n") != 0) {
+            printf("\n[FALLO] El hijo del servidor de spawn no heredó el descriptor enviado.\n");
+            return 1;
+        }
+        close(pipe_fds[0]);
+        if (zombie_wait_child(pid, REAP_TIMEOUT * 1000, &child) != 0 ||
+            !child.exited || child.exit_status != 7) {
+            printf("\n[FALLO] El servidor de spawn no reportó exit(7) para PID %d.\n", pid);
+            return 1;
+        }
+        printf("Hijo lanzado por el servidor de spawn (PID %d) reportado con exit(7) (ok)\n", pid);
     }
     
     // 3. Esperar un tiempo para que todos los hijos terminen y sean cosechados
-    printf("\nEsperando 3 segundos para permitir el reaprocesamiento automático por el SIGCHLD handler...\n");
-    sleep(3); 
+    // sleep() se interrumpe con cada SIGCHLD, por eso se consulta en intervalos cortos.
+    printf("\nEsperando hasta %d segundos para permitir el reaprocesamiento automático...\n", REAP_TIMEOUT);
+    for (i = 0; i < REAP_TIMEOUT * 10; i++) {
+        zombie_get_stats(&current_stats);
+        if (i >= 10 && current_stats.zombies_reaped == current_stats.zombies_created) break;
+        struct timespec tick = {0, 100000000};
+        nanosleep(&tick, NULL);
+    }
 
     // 4. Obtener y mostrar estadísticas
     zombie_get_stats(&current_stats);
 
     printf("\n--- Estadísticas Finales de Zombies ---\n");
-    printf("Procesos Creados (fork/spawn): %d\n", current_stats.zombies_created);
-    printf("Procesos Cosechados (Reaped): %d\n", current_stats.zombies_reaped);
-    printf("Zombies Activos (Debería ser 0): %d\n", current_stats.zombies_active);
+    printf("Procesos Creados (fork/spawn): %lld\n", current_stats.zombies_created);
+    printf("Procesos Cosechados (Reaped): %lld\n", current_stats.zombies_reaped);
+    printf("Zombies Activos (Debería ser 0): %lld\n", current_stats.zombies_active);
+
+    zombie_stats_ex_t ex;
+    zombie_get_stats_ex(&ex);
+    printf("Latencia fork->cosecha: %lld muestras, p50 <= %lld us, p99 <= %lld us, max %lld us\n",
+           ex.latency_samples, ex.latency_p50_us, ex.latency_p99_us, ex.latency_max_us);
+    if (ex.latency_samples != current_stats.zombies_created || ex.latency_max_us < 1000000) {
+        // Los hijos duermen 1 segundo: cada latencia medida debe ser >= 1 s
+        printf("\n[FALLO] El histograma de latencia no registró a todos los hijos.\n");
+        return 1;
+    }
+
+    // Contabilidad por comando: los hijos de zombie_safe_fork conservan el comm "test_lib"
+    zombie_usage_t usage[ZOMBIE_USAGE_MAX];
+    int rows = zombie_get_usage(usage, ZOMBIE_USAGE_MAX);
+    const zombie_usage_t *own = NULL;
+    for (i = 0; i < rows; i++) {
+        printf("Consumo '%s': %lld hijos, user %lld us, sys %lld us, maxrss %lld KB, %lld/%lld cambios de contexto\n",
+               usage[i].command, usage[i].children, usage[i].utime_us, usage[i].stime_us, usage[i].maxrss_kb,
+               usage[i].nvcsw, usage[i].nivcsw);
+        if (strcmp(usage[i].command, "test_lib") == 0) own = &usage[i];
+    }
+    if (!own || own->children != NUM_PROCESSES || own->maxrss_kb <= 0) {
+        printf("\n[FALLO] zombie_get_usage no acumuló el rusage de los %d hijos de 'test_lib'.\n", NUM_PROCESSES);
+        return 1;
+    }
 
     // 5. Verificación final de zombies
     printf("\nVerificación de Ausencia de Zombies ('defunct'):\n");
     system("ps aux | grep defunct | grep -v grep");
     
+    // El hijo ajeno debe seguir esperando a su padre real (no fue cosechado por la librería)
+    if (foreign_pid > 0) {
+        int status;
+        if (waitpid(foreign_pid, &status, 0) != foreign_pid || WEXITSTATUS(status) != 42) {
+            printf("\n[FALLO] El backend pidfd cosechó un hijo que no creó la librería (errno %d).\n", errno);
+            return 1;
+        }
+        printf("\nEl hijo creado fuera de la librería (PID %d) no fue cosechado por ella (ok).\n", foreign_pid);
+    }
+
     if (current_stats.zombies_active == 0 && current_stats.zombies_created == current_stats.zombies_reaped) {
         printf("\n[ÉXITO] La librería previno la creación de zombies activos y las estadísticas son correctas.\n");
         return 0;
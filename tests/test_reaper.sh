@@ -37,17 +37,19 @@ for strategy in "${STRATEGIES[@]}"; do
     # 2. Ejecutar el reaper con la estrategia actual
     # La salida incluye la creación de 10 hijos, el reaprocesamiento y la verificación
     
-    # Ejecutamos el reaper. Capturamos el PID del proceso padre (el reaper en sí).
-    $REAPER_PROG $strategy
+    # Ejecutamos el reaper en segundo plano. Capturamos el PID del proceso padre (el reaper en sí).
+    $REAPER_PROG $strategy &
+    REAPER_PID=$!
 
     # El programa zombie_reaper ya tiene una verificación interna (ps aux | grep defunct).
-    # Hacemos una verificación externa final para ser exhaustivos.
-    
-    sleep 1 # Dar un momento para que el kernel actualice los estados
+    # Hacemos una verificación externa mientras el reaper espera sus 5 segundos finales:
+    # los hijos terminan en menos de 3 s y la estrategia 1 cosecha a los 3 s.
+    sleep 4.5
 
-    # 3. Verificación externa: Contar procesos "defunct" restantes
-    # Filtramos por procesos defunct (Z) y excluimos la línea del propio grep
-    ZOMBIE_REMAINING=$(ps aux | grep 'defunct' | grep -v grep | wc -l)
+    # 3. Verificación externa: contar solo los zombies hijos del reaper (otros zombies
+    # del sistema no cuentan)
+    ZOMBIE_REMAINING=$(ps -o ppid,stat -ax | awk -v pid="$REAPER_PID" '$1 == pid && $2 ~ /^Z/' | wc -l)
+    wait $REAPER_PID
     
     echo ""
     echo "--- External Verification ---"
@@ -58,11 +60,62 @@ for strategy in "${STRATEGIES[@]}"; do
     else
         echo "  [FAILURE] $DESC: $ZOMBIE_REMAINING zombies remain after reaping!"
         # Mostrar los zombies que quedan
-        ps aux | grep 'defunct' | grep -v grep
+        ps -o pid,ppid,stat,comm -ax | awk -v pid="$REAPER_PID" '$2 == pid && $3 ~ /^Z/'
     fi
     
 done
 
+# 4. Modo --bench: una fila CSV completa por estrategia
+TOTAL_TESTS=$((TOTAL_TESTS + 1))
+echo ""
+echo "=========================================================="
+echo "Starting Test for --bench (5 strategies, 2000 children in batches of 500)"
+echo "=========================================================="
+# El benchmark corre bajo --subreaper: un hijo que deje sin cosechar pasa al subreaper al
+# salir y se cuenta como descendiente huérfano (solo los suyos, no los del resto del sistema)
+BENCH_OUTPUT=$($REAPER_PROG --subreaper -- $REAPER_PROG --bench -n 2000 -b 500 -s 10000 2>&1)
+echo "$BENCH_OUTPUT"
+BENCH_ROWS=$(echo "$BENCH_OUTPUT" | grep -cE '^(waitpid|handler|signalfd|pidfd),2000,500,10000,[0-9.]+,[0-9]+,[0-9.]+,[0-9.]+,[0-9.]+,[0-9.]+$')
+SIGIGN_ROWS=$(echo "$BENCH_OUTPUT" | grep -cE '^sigign,2000,500,10000,[0-9.]+,[0-9]+,,,,$')
+ZOMBIE_REMAINING=$(echo "$BENCH_OUTPUT" | sed -n 's/.*(\([0-9]*\) orphaned descendants).*/\1/p')
+ZOMBIE_REMAINING=${ZOMBIE_REMAINING:-unknown}
+
+if [ "$BENCH_ROWS" -eq 4 ] && [ "$SIGIGN_ROWS" -eq 1 ] && [ "$ZOMBIE_REMAINING" = "0" ]; then
+    echo "  [SUCCESS] --bench: 5 strategies measured, NO zombies remain."
+    PASSED_TESTS=$((PASSED_TESTS + 1))
+else
+    echo "  [FAILURE] --bench: $BENCH_ROWS latency rows (expected 4), $SIGIGN_ROWS sigign rows, $ZOMBIE_REMAINING zombies remain."
+fi
+
+# 5. Modo --subreaper: los nietos huérfanos se cosechan aquí y no en PID 1
+TOTAL_TESTS=$((TOTAL_TESTS + 1))
+ORPHANS=50
+echo ""
+echo "=========================================================="
+echo "Starting Test for --subreaper ($ORPHANS orphaned grandchildren, workload exits with 3)"
+echo "=========================================================="
+SUB_OUTPUT=$($REAPER_PROG --subreaper -- sh -c "for i in \$(seq $ORPHANS); do (sleep 0.2 &); done; sleep 0.5; exit 3" 2>&1)
+SUB_STATUS=$?
+echo "$SUB_OUTPUT"
+
+# Mientras sigue vivo, ninguno de sus hijos (los huérfanos adoptados) puede quedar zombie;
+# solo cuentan los zombies cuyo padre es este subreaper
+$REAPER_PROG --subreaper -- sh -c "for i in \$(seq 20); do (sleep 0.1 &); done; sleep 10" &
+SUB_PID=$!
+sleep 0.8
+SUB_ZOMBIES=$(ps -o ppid,stat -ax | awk -v pid="$SUB_PID" '$1 == pid && $2 ~ /^Z/' | wc -l)
+kill -TERM $SUB_PID
+wait $SUB_PID
+SIG_STATUS=$?
+
+if [ "$SUB_STATUS" -eq 3 ] && echo "$SUB_OUTPUT" | grep -q "($ORPHANS orphaned descendants)" && \
+   echo "$SUB_OUTPUT" | grep -q "usage 'sleep': $ORPHANS reaped" && [ "$SIG_STATUS" -eq 143 ] && [ "$SUB_ZOMBIES" -eq 0 ]; then
+    echo "  [SUCCESS] --subreaper: $ORPHANS orphans reaped with per-command usage, exit status 3 propagated, SIGTERM forwarded (143), 0 zombies."
+    PASSED_TESTS=$((PASSED_TESTS + 1))
+else
+    echo "  [FAILURE] --subreaper: exit status $SUB_STATUS (expected 3), SIGTERM status $SIG_STATUS (expected 143), $SUB_ZOMBIES zombies."
+fi
+
 echo ""
 echo "=========================================================="
 echo "--- Summary of Zombie Reaper Tests ---"